@@ -0,0 +1,632 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Microbenchmarks of the request formatting and response decoding code,
+   using synthetic responses for all reports and their response variants */
+
+#include "synth.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* mallinfo2() is available only in glibc 2.33 and later */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2
+#endif
+
+#define MAX_NAME_LEN 32
+
+/* Number of sessions created to measure their memory footprint and the
+   target footprint of a session (in bytes) */
+#define FOOTPRINT_SESSIONS 1000
+#define FOOTPRINT_TARGET 2048
+
+typedef struct {
+	const Report *report;
+	const Request *request;
+	const RequestTemplate *request_template;
+	const Response *responses;
+	void *values[1];
+	uint32_t index;
+	char address[20];
+	Message request_msg;
+	Message response_msg;
+	int num_fields;
+	chrony_session *session;
+	int server_fd;
+	chrony_stats *stats;
+	chrony_snapshot *snapshot;
+	int changed_fields[64];
+	char json[4096];
+	struct iovec json_iov[256];
+	const char *field_names[64];
+	ProjectedField projected[4];
+	chrony_field_value projected_values[4];
+	union {
+		chrony_tracking_record tracking;
+		chrony_sources_record sources;
+		chrony_sourcestats_record sourcestats;
+		chrony_selectdata_record selectdata;
+		chrony_activity_record activity;
+		chrony_authdata_record authdata;
+		chrony_ntpdata_record ntpdata;
+		chrony_serverstats_record serverstats;
+		chrony_rtcdata_record rtcdata;
+		chrony_smoothing_record smoothing;
+	} record;
+} Context;
+
+typedef void (*BenchFunction)(Context *c, long iterations);
+
+static double min_time = 0.2;
+static const char *filter;
+static volatile uint64_t sink;
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run_bench(const char *name, const char *variant, BenchFunction fn,
+		      Context *c, int ops_per_record) {
+	double t, ns_per_op;
+	long n;
+
+	if (filter && !strstr(name, filter))
+		return;
+
+	/* Warm up and find the number of iterations running for min_time */
+	for (n = 100; ; n *= 2) {
+		t = get_time();
+		fn(c, n);
+		t = get_time() - t;
+		if (t >= min_time)
+			break;
+	}
+
+	/* Each iteration processes one record */
+	ns_per_op = t * 1e9 / n / (ops_per_record > 0 ? ops_per_record : 1);
+	printf("%-31s %-14s %10.1f ns/op %14.0f records/s\n", name, variant, ns_per_op,
+	       n / t);
+}
+
+static void bench_format_request(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		format_request(&c->request_msg, i, c->request_template, c->values);
+	sink += c->request_msg.len;
+}
+
+static void bench_is_response_valid(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += is_response_valid(&c->request_msg, &c->response_msg);
+}
+
+static void bench_process_response(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += process_response(&c->response_msg, c->responses, NULL);
+}
+
+static void bench_process_response_schema(Context *c, long iterations) {
+	Schema schema = { 0 };
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += process_response(&c->response_msg, c->responses, &schema);
+}
+
+static void bench_get_field_uinteger(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_uinteger(&c->response_msg, j);
+	}
+}
+
+static void bench_get_field_integer(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_integer(&c->response_msg, j);
+	}
+}
+
+static void bench_get_field_float(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_float(&c->response_msg, j) > 0.0;
+	}
+}
+
+static void bench_get_field_timespec(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_timespec(&c->response_msg, j).tv_nsec;
+	}
+}
+
+static void bench_get_field_string(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_string(&c->response_msg, j) != NULL;
+	}
+}
+
+static void bench_get_field_constant_name(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_constant_name(&c->response_msg, j,
+							get_field_uinteger(&c->response_msg, j)) != NULL;
+	}
+}
+
+static void bench_get_field_flag_names(Context *c, long iterations) {
+	const char *names[64];
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += get_field_flag_names(&c->response_msg, j,
+						     get_field_uinteger(&c->response_msg, j),
+						     names, 64);
+	}
+}
+
+static void bench_get_field_record(Context *c, long iterations) {
+	const Message *msg = &c->response_msg;
+	long i;
+	int j;
+
+	/* Interpreted decoding of all fields, as with the public accessors */
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++) {
+			switch (resolve_field_type(msg, j)) {
+			case TYPE_UINT64:
+			case TYPE_UINT32:
+			case TYPE_UINT16:
+			case TYPE_UINT8:
+				sink += get_field_uinteger(msg, j);
+				break;
+			case TYPE_INT16:
+			case TYPE_INT8:
+				sink += get_field_integer(msg, j);
+				break;
+			case TYPE_FLOAT:
+				sink += get_field_float(msg, j) > 0.0;
+				break;
+			case TYPE_TIMESPEC:
+				sink += get_field_timespec(msg, j).tv_nsec;
+				break;
+			case TYPE_ADDRESS:
+				sink += get_field_string(msg, j) != NULL;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+static void bench_project_fields(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		project_fields(&c->response_msg, c->projected, 4, c->projected_values);
+		sink += c->projected_values[0].uinteger;
+	}
+}
+
+static bool decode_record(Context *c) {
+	const Message *msg = &c->response_msg;
+
+	return decode_tracking_record(msg, &c->record.tracking) ||
+		decode_sources_record(msg, &c->record.sources) ||
+		decode_sourcestats_record(msg, &c->record.sourcestats) ||
+		decode_selectdata_record(msg, &c->record.selectdata) ||
+		decode_activity_record(msg, &c->record.activity) ||
+		decode_authdata_record(msg, &c->record.authdata) ||
+		decode_ntpdata_record(msg, &c->record.ntpdata) ||
+		decode_serverstats_record(msg, &c->record.serverstats) ||
+		decode_rtcdata_record(msg, &c->record.rtcdata) ||
+		decode_smoothing_record(msg, &c->record.smoothing);
+}
+
+static void bench_decode_record(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += decode_record(c);
+}
+
+static void bench_resolve_field_type(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += resolve_field_type(&c->response_msg, j);
+	}
+}
+
+static void bench_resolve_field_name(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += resolve_field_name(&c->response_msg, j) != NULL;
+	}
+}
+
+static void bench_resolve_field_content(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += resolve_field_content(&c->response_msg, j);
+	}
+}
+
+static void bench_get_field_index(Context *c, long iterations) {
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < c->num_fields; j++)
+			sink += chrony_get_field_index(c->session, c->field_names[j]);
+	}
+}
+
+static void bench_update_stats(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		chrony_update_stats(c->stats, c->session);
+}
+
+static void bench_get_stats_quantile(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += chrony_get_stats_quantile(c->stats, 0, 0.99) > 0.0;
+}
+
+static void bench_diff_record(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += chrony_diff_record(c->session, c->snapshot, c->changed_fields, 64);
+}
+
+static void bench_format_record_json(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += chrony_format_record_json(c->session, 0, c->json, sizeof (c->json));
+}
+
+static void bench_format_record_json_iov(Context *c, long iterations) {
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		sink += chrony_format_record_json_iov(c->session, 0, c->json_iov,
+						      sizeof (c->json_iov) / sizeof (c->json_iov[0]),
+						      c->json, sizeof (c->json));
+}
+
+static bool serve_requests(Context *c, const SynthConfig *config) {
+	chrony_err r;
+	int len;
+
+	while (chrony_needs_response(c->session)) {
+		len = recv(c->server_fd, c->request_msg.msg, sizeof (c->request_msg.msg), 0);
+		if (len < 0)
+			return false;
+		c->request_msg.len = len;
+		if (!synth_respond(&c->response_msg, &c->request_msg, config) ||
+		    send(c->server_fd, c->response_msg.msg, c->response_msg.len, 0) < 0)
+			return false;
+		r = chrony_process_response(c->session);
+		if (r != CHRONY_OK) {
+			fprintf(stderr, "Error: %s\n", chrony_get_error_string(r));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void bench_session_record(Context *c, long iterations) {
+	SynthConfig config = { .num_sources = 1, .response_variant = MAX_RESPONSES - 1 };
+	long i;
+
+	for (i = 0; i < iterations; i++) {
+		if (chrony_request_record(c->session, c->report->name, 0) != CHRONY_OK ||
+		    !serve_requests(c, &config))
+			exit(1);
+	}
+}
+
+static void bench_response(Context *c, const Response *response) {
+	char variant[MAX_NAME_LEN];
+	int i, n;
+
+	for (n = 0; response->fields[n].type != TYPE_NONE; n++)
+		;
+	c->num_fields = n;
+
+	snprintf(variant, sizeof (variant), "%s/%d", c->report->name, response->code);
+
+	synth_format_response(&c->response_msg, &c->request_msg, response, 0, 1);
+	if (!is_response_valid(&c->request_msg, &c->response_msg) ||
+	    process_response(&c->response_msg, c->responses, NULL) != CHRONY_OK) {
+		fprintf(stderr, "Invalid synthetic response %s\n", variant);
+		exit(1);
+	}
+
+	run_bench("is_response_valid()", variant, bench_is_response_valid, c, 1);
+	run_bench("process_response()", variant, bench_process_response, c, 1);
+	run_bench("process_response() schema", variant, bench_process_response_schema, c, 1);
+
+	run_bench("get_field_uinteger()", variant, bench_get_field_uinteger, c, n);
+	run_bench("get_field_integer()", variant, bench_get_field_integer, c, n);
+	run_bench("get_field_float()", variant, bench_get_field_float, c, n);
+	run_bench("get_field_timespec()", variant, bench_get_field_timespec, c, n);
+	run_bench("get_field_string()", variant, bench_get_field_string, c, n);
+	run_bench("get_field_constant_name()", variant, bench_get_field_constant_name, c, n);
+	run_bench("get_field_flag_names()", variant, bench_get_field_flag_names, c, n);
+
+	/* Project four fields spread over the record */
+	for (i = 0; i < 4; i++)
+		resolve_projected_field(response->fields, response->fields[i * n / 4].name,
+					&c->projected[i]);
+	run_bench("project_fields() 4 fields", variant, bench_project_fields, c, 1);
+
+	run_bench("get_field_*() record", variant, bench_get_field_record, c, 1);
+	if (decode_record(c))
+		run_bench("decode_*_record()", variant, bench_decode_record, c, 1);
+
+	if (strcmp(c->report->name, "sources") == 0) {
+		for (i = 0; i < 2; i++) {
+			/* Cover both an address and reference clock */
+			synth_format_response(&c->response_msg, &c->request_msg, response,
+					      i == 0 ? 0 : 7, 8);
+			process_response(&c->response_msg, c->responses, NULL);
+			snprintf(variant, sizeof (variant), "%s/%d/%s", c->report->name,
+				 response->code, i == 0 ? "addr" : "refid");
+			run_bench("resolve_field_type()", variant,
+				  bench_resolve_field_type, c, n);
+			run_bench("resolve_field_name()", variant,
+				  bench_resolve_field_name, c, n);
+			run_bench("resolve_field_content()", variant,
+				  bench_resolve_field_content, c, n);
+		}
+	}
+}
+
+static void bench_report(Context *c, int report_index) {
+	int i;
+
+	c->report = get_report(report_index);
+
+	if (c->report->count_requests[0].code) {
+		c->request = &c->report->count_requests[0];
+		c->request_template = get_request_template(report_index, true);
+		c->responses = c->report->count_responses;
+		c->values[0] = NULL;
+		format_request(&c->request_msg, 1, c->request_template, c->values);
+		run_bench("format_request()", "count", bench_format_request, c, 1);
+	}
+
+	c->request = &c->report->record_requests[0];
+	c->request_template = get_request_template(report_index, false);
+	c->responses = c->report->record_responses;
+
+	c->values[0] = NULL;
+	if (c->request->fields) {
+		c->index = 0;
+		synth_get_source_address(0, c->address);
+		c->values[0] = c->request->fields[0].type == TYPE_ADDRESS ?
+			(void *)c->address : (void *)&c->index;
+	}
+
+	format_request(&c->request_msg, 1, c->request_template, c->values);
+	run_bench("format_request()", c->report->name, bench_format_request, c, 1);
+
+	for (i = 0; i < MAX_RESPONSES && c->responses[i].fields; i++)
+		bench_response(c, &c->responses[i]);
+}
+
+static void bench_session_report(Context *c, int report_index) {
+	SynthConfig config = { .num_sources = 1, .response_variant = MAX_RESPONSES - 1 };
+	int i;
+
+	c->report = get_report(report_index);
+
+	if (chrony_request_record(c->session, c->report->name, 0) != CHRONY_OK ||
+	    !serve_requests(c, &config)) {
+		fprintf(stderr, "Could not get %s record\n", c->report->name);
+		exit(1);
+	}
+
+	c->num_fields = chrony_get_record_number_fields(c->session);
+	for (i = 0; i < c->num_fields && i < sizeof (c->field_names) / sizeof (c->field_names[0]); i++)
+		c->field_names[i] = chrony_get_field_name(c->session, i);
+
+	run_bench("chrony_get_field_index()", c->report->name, bench_get_field_index,
+		  c, c->num_fields);
+	run_bench("session request+response", c->report->name, bench_session_record, c, 1);
+
+	/* Records which didn't change since the snapshot */
+	if (chrony_init_snapshot(&c->snapshot) != CHRONY_OK ||
+	    chrony_save_snapshot(c->snapshot, c->session) != CHRONY_OK)
+		exit(1);
+	run_bench("chrony_diff_record()", c->report->name, bench_diff_record, c, 1);
+	chrony_deinit_snapshot(c->snapshot);
+
+	run_bench("chrony_format_record_json()", c->report->name,
+		  bench_format_record_json, c, 1);
+	run_bench("chrony_format_record_json_iov()", c->report->name,
+		  bench_format_record_json_iov, c, 1);
+
+	if (chrony_init_stats(&c->stats, 0.1) != CHRONY_OK)
+		exit(1);
+	chrony_update_stats(c->stats, c->session);
+	if (chrony_get_stats_number_fields(c->stats) > 0) {
+		run_bench("chrony_update_stats()", c->report->name, bench_update_stats, c, 1);
+		run_bench("chrony_get_stats_quantile()", c->report->name,
+			  bench_get_stats_quantile, c, 1);
+	}
+	chrony_deinit_stats(c->stats);
+}
+
+/* Measure the heap memory used by sessions after making a request, which
+   includes buffers allocated on the first use */
+static bool bench_session_footprint(void) {
+#ifdef HAVE_MALLINFO2
+	static chrony_session *sessions[FOOTPRINT_SESSIONS];
+	struct sockaddr_in sin;
+	size_t before, after;
+	double footprint;
+	socklen_t len;
+	int i, fd[2];
+
+	if (filter && !strstr("session footprint", filter))
+		return true;
+
+	/* The requests are sent over UDP to not block on a full socket */
+	memset(&sin, 0, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	len = sizeof (sin);
+	fd[0] = socket(AF_INET, SOCK_DGRAM, 0);
+	fd[1] = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd[0] < 0 || fd[1] < 0 || bind(fd[1], (struct sockaddr *)&sin, sizeof (sin)) < 0 ||
+	    getsockname(fd[1], (struct sockaddr *)&sin, &len) < 0 ||
+	    connect(fd[0], (struct sockaddr *)&sin, sizeof (sin)) < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	before = mallinfo2().uordblks;
+
+	for (i = 0; i < FOOTPRINT_SESSIONS; i++) {
+		if (chrony_init_session(&sessions[i], fd[0]) != CHRONY_OK ||
+		    chrony_request_record(sessions[i], "tracking", 0) != CHRONY_OK)
+			exit(1);
+	}
+
+	after = mallinfo2().uordblks;
+
+	for (i = 0; i < FOOTPRINT_SESSIONS; i++)
+		chrony_deinit_session(sessions[i]);
+
+	close(fd[0]);
+	close(fd[1]);
+
+	footprint = (double)(after - before) / FOOTPRINT_SESSIONS;
+	printf("%-31s %-14s %10.0f bytes %14d target\n", "session footprint", "",
+	       footprint, FOOTPRINT_TARGET);
+
+	return footprint <= FOOTPRINT_TARGET;
+#else
+	if (!filter || strstr("session footprint", filter))
+		printf("%-31s %s\n", "session footprint", "skipped (no mallinfo2())");
+
+	return true;
+#endif
+}
+
+int main(int argc, char **argv) {
+	Context context;
+	int i, opt, fd[2];
+
+	while ((opt = getopt(argc, argv, "t:h")) != -1) {
+		switch (opt) {
+		case 't':
+			min_time = atof(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-t MIN-SECONDS] [FILTER]\n", argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (optind < argc)
+		filter = argv[optind];
+
+	memset(&context, 0, sizeof (context));
+
+	for (i = 0; i < chrony_get_number_supported_reports(); i++)
+		bench_report(&context, i);
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	context.server_fd = fd[1];
+	if (chrony_init_session(&context.session, fd[0]) != CHRONY_OK)
+		return 1;
+
+	for (i = 0; i < chrony_get_number_supported_reports(); i++)
+		bench_session_report(&context, i);
+
+	chrony_deinit_session(context.session);
+	close(fd[0]);
+	close(fd[1]);
+
+	if (!bench_session_footprint()) {
+		fprintf(stderr, "Session footprint exceeds target\n");
+		return 1;
+	}
+
+	return 0;
+}
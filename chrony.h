@@ -75,6 +75,9 @@ typedef enum {
 	CHRONY_OLD_SERVER,
 	CHRONY_NEW_SERVER,
 	CHRONY_INVALID_RESPONSE,
+	CHRONY_NO_RESPONSE,
+	CHRONY_NO_PIPE,
+	CHRONY_QUEUE_FULL,
 } chrony_err;
 
 /**
@@ -84,13 +87,56 @@ typedef enum {
  */
 const char *chrony_get_error_string(chrony_err e);
 
+/**
+ * Type for an asynchronous opening of a client socket.
+ */
+typedef struct chrony_opener_t chrony_opener;
+/**
+ * Start opening a client socket connected to chronyd without blocking the
+ * caller. UDP sockets are opened immediately. The Unix domain socket is
+ * opened in a separate thread as it needs to create directories in the
+ * filesystem.
+ * @param o		Pointer to the pointer to the new opener.
+ * @param address	Address of the server socket (see chrony_open_socket()).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_opener(chrony_opener **o, const char *address);
+/**
+ * Destroy the opener. It does not wait for an opening which is not
+ * completed yet, the socket will be closed in the thread when the opening
+ * finishes. The opened socket is closed if it was not retrieved by
+ * chrony_get_opened_socket().
+ * @param o		Opener.
+ */
+void chrony_deinit_opener(chrony_opener *o);
+/**
+ * Get the file descriptor which becomes readable when the opening is
+ * completed (e.g. to wait for it in poll() together with sessions).
+ * @param o		Opener.
+ * @return		File descriptor.
+ */
+int chrony_get_opener_fd(chrony_opener *o);
+/**
+ * Get the socket opened by the opener. It should be called when the file
+ * descriptor returned by chrony_get_opener_fd() is readable. The caller
+ * becomes the owner of the socket and needs to close it by
+ * chrony_close_socket().
+ * @param o		Opener.
+ * @return		File descriptor of the socket, or a negative value with
+ * 			errno set to EINPROGRESS if the opening is not completed
+ * 			yet, or to the error of the opening if it failed.
+ */
+int chrony_get_opened_socket(chrony_opener *o);
+
 /**
  * Type for a client-server session.
  */
 typedef struct chrony_session_t chrony_session;
 
 /**
- * Create a new client-server session.
+ * Create a new client-server session. A session uses less than 2 kB of
+ * memory, except for the source view and probe of reports allocated on
+ * their first use. /dev/urandom is opened once for all sessions.
  * @param s		Pointer to pointer where the new session should
  * 			be saved.
  * @param fd		Socket returned by chrony_open_socket().
@@ -110,11 +156,27 @@ void chrony_deinit_session(chrony_session *s);
  */
 int chrony_get_fd(chrony_session *s);
 
+/**
+ * Capture all requests sent and datagrams received in the session, e.g. to
+ * replay them later. Each record in the capture starts with a 2-byte length
+ * of the rest of the record, followed by the time (4-byte seconds and
+ * 4-byte nanoseconds since the Unix epoch) and the message. All numbers are
+ * in network byte order. Requests and responses can be distinguished by the
+ * second byte of the message (1 for requests, 2 for responses). Errors in
+ * writing to the capture are ignored.
+ * @param s		Session.
+ * @param fd		File descriptor where the records should be written,
+ * 			or -1 to stop capturing.
+ */
+void chrony_set_session_capture(chrony_session *s, int fd);
+
 /**
  * Check if the session is waiting for a server response after sending a
  * request, i.e. when the application should wait for a timeout or read event
  * on the socket and then call chrony_process_response(). Multiple responses
  * might need to be processed before the requested information is available.
+ * A request queued by a limiter (see chrony_get_send_delay()) is also waiting
+ * for the response.
  * @param s		Session.
  * @return		true if waiting for the response, false otherwise.
  */
@@ -147,10 +209,15 @@ const char *chrony_get_report_name(int report);
 /**
  * Send a request to the server to get the number of records available for
  * a given report. The number will be available after chrony_process_response()
- * returns success.
+ * returns success. If the server rejected the request before in the session
+ * (CHRONY_OLD_SERVER, CHRONY_UNAUTHORIZED, or CHRONY_DISABLED), it is not
+ * sent again until the availability of reports is refreshed by
+ * chrony_probe_reports() or reset by chrony_reset_report_availability()
+ * (e.g. after the server was reconfigured or upgraded).
  * @param s		Session.
  * @param report_name	Name of the report.
- * @return		Error code (CHRONY_OK on success).
+ * @return		Error code (CHRONY_OK on success, or the error of the
+ * 			server if the request was rejected before).
  */
 chrony_err chrony_request_report_number_records(chrony_session *s, const char *report_name);
 /**
@@ -166,14 +233,50 @@ int chrony_get_report_number_records(chrony_session *s);
 /**
  * Send a request to the server to get a record of a report. The number
  * of fields in the record and their values will be available after
- * chrony_process_response() returns success.
+ * chrony_process_response() returns success. The session remembers the
+ * format of responses of the server to process them faster and to pad the
+ * requests to the expected length of the response. If the server rejected
+ * the request before in the session (CHRONY_OLD_SERVER, CHRONY_UNAUTHORIZED,
+ * or CHRONY_DISABLED), it is not sent again until the availability of reports
+ * is refreshed by chrony_probe_reports() or reset by
+ * chrony_reset_report_availability().
  * @param s		Session.
  * @param report_name	Name of the report.
  * @param record	Index of the record (starting at 0).
- * @return		Error code (CHRONY_OK on success).
+ * @return		Error code (CHRONY_OK on success, or the error of the
+ * 			server if the request was rejected before).
  */
 chrony_err chrony_request_record(chrony_session *s, const char *report_name, int record);
 
+/**
+ * Send requests to the server to find out which reports are available in
+ * the session (supported by the server, authorized, and enabled). The
+ * requests are pipelined. Responses need to be processed by
+ * chrony_process_response() until chrony_needs_response() returns false.
+ * The results are cached in the session and rejected reports are not
+ * requested again. Reports rejected before are probed again.
+ * @param s		Session.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_probe_reports(chrony_session *s);
+/**
+ * Get the availability of a report in the session, as found out by
+ * chrony_probe_reports() or previous requests of the report.
+ * @param s		Session.
+ * @param report_name	Name of the report.
+ * @return		CHRONY_OK if the report is available, CHRONY_OLD_SERVER,
+ * 			CHRONY_UNAUTHORIZED, or CHRONY_DISABLED if it was
+ * 			rejected by the server, CHRONY_UNEXPECTED_CALL if it is
+ * 			not known yet, or CHRONY_UNKNOWN_REPORT.
+ */
+chrony_err chrony_get_report_availability(chrony_session *s, const char *report_name);
+/**
+ * Forget the availability of all reports in the session, which allows
+ * requests rejected before to be sent again, without probing the reports.
+ * @param s		Session.
+ */
+void chrony_reset_report_availability(chrony_session *s);
+
 /**
  * Enum for record field data types.
  */
@@ -252,6 +355,14 @@ chrony_field_type chrony_get_field_type(chrony_session *s, int field);
  * 			the field is missing).
  */
 chrony_field_content chrony_get_field_content(chrony_session *s, int field);
+/**
+ * Check if a field is reserved, i.e. it does not have a meaningful value.
+ * @param s		Session.
+ * @param field		Index of the field in the record (starting at 0).
+ * @return		true if the field is reserved, false otherwise (or if
+ * 			the field is missing).
+ */
+bool chrony_is_field_reserved(chrony_session *s, int field);
 
 /**
  * Get the value of an unsigned integer field.
@@ -301,6 +412,925 @@ const char *chrony_get_field_string(chrony_session *s, int field);
  * 			destroyed.
  */
 const char *chrony_get_field_constant_name(chrony_session *s, int field, uint64_t value);
+/**
+ * Get the names of all flags set in the value of a CHRONY_CONTENT_FLAGS field
+ * (in the order of their bits). Flags without a name are ignored.
+ * @param s		Session.
+ * @param field		Index of the field in the record (starting at 0).
+ * @param value		Value of the field.
+ * @param names		Array where the pointers to the names should be saved.
+ * 			They are valid until the session is destroyed.
+ * @param max_names	Maximum number of names saved in the array.
+ * @return		Number of named flags set in the value (which can be
+ * 			larger than max_names), or -1 if the field does not have
+ * 			flags.
+ */
+int chrony_get_field_flag_names(chrony_session *s, int field, uint64_t value,
+				const char **names, int max_names);
+
+/**
+ * Maximum length of an address string in decoded records, including the
+ * terminating null character.
+ */
+#define CHRONY_MAX_ADDRESS_LEN 48
+
+/**
+ * Value of unsigned integer members of decoded records which are not
+ * provided by the server (e.g. due to an older version).
+ */
+#define CHRONY_ABSENT_UINTEGER UINT64_MAX
+
+/**
+ * Record of the tracking report.
+ */
+typedef struct {
+	uint64_t reference_id;
+	char address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t stratum;
+	uint64_t leap_status;
+	struct timespec reference_time;
+	double current_correction;
+	double last_offset;
+	double rms_offset;
+	double frequency_offset;
+	double residual_frequency;
+	double skew;
+	double root_delay;
+	double root_dispersion;
+	double last_update_interval;
+} chrony_tracking_record;
+
+/**
+ * Record of the sources report. The address is empty and reference ID
+ * present only for reference clocks (mode 2).
+ */
+typedef struct {
+	char address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t reference_id;
+	int64_t poll;
+	uint64_t stratum;
+	uint64_t state;
+	uint64_t mode;
+	uint64_t flags;
+	uint64_t reachability;
+	uint64_t last_sample_ago;
+	double original_last_sample_offset;
+	double adjusted_last_sample_offset;
+	double last_sample_error;
+} chrony_sources_record;
+
+/**
+ * Record of the sourcestats report.
+ */
+typedef struct {
+	uint64_t reference_id;
+	char address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t samples;
+	uint64_t runs;
+	uint64_t span;
+	double standard_deviation;
+	double residual_frequency;
+	double skew;
+	double offset;
+	double offset_error;
+} chrony_sourcestats_record;
+
+/**
+ * Record of the selectdata report.
+ */
+typedef struct {
+	uint64_t reference_id;
+	char address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t state;
+	uint64_t authentication;
+	uint64_t leap_status;
+	uint64_t configured_options;
+	uint64_t effective_options;
+	uint64_t last_sample_ago;
+	double score;
+	double low_limit;
+	double high_limit;
+} chrony_selectdata_record;
+
+/**
+ * Record of the activity report.
+ */
+typedef struct {
+	uint64_t online_sources;
+	uint64_t offline_sources;
+	uint64_t burst_online_return_sources;
+	uint64_t burst_offline_return_sources;
+	uint64_t unresolved_sources;
+} chrony_activity_record;
+
+/**
+ * Record of the authdata report.
+ */
+typedef struct {
+	uint64_t mode;
+	uint64_t key_type;
+	uint64_t key_id;
+	uint64_t key_length;
+	uint64_t key_establishment_attempts;
+	uint64_t last_key_establishment_ago;
+	uint64_t cookies;
+	uint64_t cookie_length;
+	uint64_t nak;
+} chrony_authdata_record;
+
+/**
+ * Record of the ntpdata report. The timestamp counters are provided only
+ * by newer servers.
+ */
+typedef struct {
+	char remote_address[CHRONY_MAX_ADDRESS_LEN];
+	char local_address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t remote_port;
+	uint64_t leap_status;
+	uint64_t version;
+	uint64_t mode;
+	uint64_t stratum;
+	int64_t poll;
+	int64_t precision;
+	double root_delay;
+	double root_dispersion;
+	uint64_t reference_id;
+	struct timespec reference_time;
+	double offset;
+	double peer_delay;
+	double peer_dispersion;
+	double response_time;
+	double jitter_asymmetry;
+	uint64_t flags;
+	uint64_t transmit_timestamping;
+	uint64_t receive_timestamping;
+	uint64_t transmitted_messages;
+	uint64_t received_messages;
+	uint64_t received_valid_messages;
+	uint64_t received_good_messages;
+	uint64_t kernel_transmit_timestamps;
+	uint64_t kernel_receive_timestamps;
+	uint64_t hardware_transmit_timestamps;
+	uint64_t hardware_receive_timestamps;
+} chrony_ntpdata_record;
+
+/**
+ * Record of the serverstats report. Most counters are provided only by
+ * newer servers.
+ */
+typedef struct {
+	uint64_t received_ntp_requests;
+	uint64_t accepted_nts_ke_connections;
+	uint64_t received_command_requests;
+	uint64_t dropped_ntp_requests;
+	uint64_t dropped_nts_ke_connections;
+	uint64_t dropped_command_requests;
+	uint64_t dropped_client_log_records;
+	uint64_t received_authenticated_ntp_requests;
+	uint64_t received_interleaved_ntp_requests;
+	uint64_t held_ntp_timestamps;
+	uint64_t ntp_timestamp_span;
+	uint64_t served_daemon_rx_timestamps;
+	uint64_t served_daemon_tx_timestamps;
+	uint64_t served_kernel_rx_timestamps;
+	uint64_t served_kernel_tx_timestamps;
+	uint64_t served_hardware_rx_timestamps;
+	uint64_t served_hardware_tx_timestamps;
+} chrony_serverstats_record;
+
+/**
+ * Record of the rtcdata report.
+ */
+typedef struct {
+	struct timespec reference_time;
+	uint64_t samples;
+	uint64_t runs;
+	uint64_t span;
+	double offset;
+	double frequency_offset;
+} chrony_rtcdata_record;
+
+/**
+ * Record of the smoothing report.
+ */
+typedef struct {
+	uint64_t flags;
+	double offset;
+	double frequency_offset;
+	double wander;
+	double last_update_ago;
+	double remaining_time;
+} chrony_smoothing_record;
+
+/**
+ * Decode all fields of the requested record of the tracking report in one
+ * pass. The values have the same types as returned by the
+ * chrony_get_field_*() functions and the same units as described by
+ * the field content.
+ * @param s		Session.
+ * @param record	Pointer to the record which should be filled.
+ * @return		Error code (CHRONY_OK on success, CHRONY_INVALID_ARGUMENT
+ * 			if the session does not have a record of the report).
+ */
+chrony_err chrony_get_tracking_record(chrony_session *s, chrony_tracking_record *record);
+/**
+ * Decode the requested record of the sources report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_sources_record(chrony_session *s, chrony_sources_record *record);
+/**
+ * Decode the requested record of the sourcestats report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_sourcestats_record(chrony_session *s, chrony_sourcestats_record *record);
+/**
+ * Decode the requested record of the selectdata report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_selectdata_record(chrony_session *s, chrony_selectdata_record *record);
+/**
+ * Decode the requested record of the activity report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_activity_record(chrony_session *s, chrony_activity_record *record);
+/**
+ * Decode the requested record of the authdata report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_authdata_record(chrony_session *s, chrony_authdata_record *record);
+/**
+ * Decode the requested record of the ntpdata report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_ntpdata_record(chrony_session *s, chrony_ntpdata_record *record);
+/**
+ * Decode the requested record of the serverstats report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_serverstats_record(chrony_session *s, chrony_serverstats_record *record);
+/**
+ * Decode the requested record of the rtcdata report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_rtcdata_record(chrony_session *s, chrony_rtcdata_record *record);
+/**
+ * Decode the requested record of the smoothing report.
+ * @see chrony_get_tracking_record()
+ */
+chrony_err chrony_get_smoothing_record(chrony_session *s, chrony_smoothing_record *record);
+
+/**
+ * Type for a projection plan, which selects fields of a report and has
+ * their positions and types resolved for all supported versions of the
+ * report.
+ */
+typedef struct chrony_projection_t chrony_projection;
+
+/**
+ * Value of a field extracted with a projection plan. The member which is
+ * valid is given by the type of the field.
+ */
+typedef union {
+	uint64_t uinteger;
+	int64_t integer;
+	double floating;
+	struct timespec timespec;
+	char string[CHRONY_MAX_ADDRESS_LEN];
+} chrony_field_value;
+
+/**
+ * Create a new projection plan for records of a report.
+ * @param p		Pointer to pointer where the new plan should be saved.
+ * @param report_name	Name of the report.
+ * @param field_names	Array of names of the fields (as returned by
+ * 			chrony_get_field_name()).
+ * @param num_fields	Number of fields in the array.
+ * @return		Error code (CHRONY_OK on success, CHRONY_INVALID_ARGUMENT
+ * 			if a field is not present in any version of the report).
+ */
+chrony_err chrony_init_projection(chrony_projection **p, const char *report_name,
+				  const char *const *field_names, int num_fields);
+/**
+ * Destroy the projection plan.
+ * @param p		Projection plan.
+ */
+void chrony_deinit_projection(chrony_projection *p);
+/**
+ * Get the type of a value extracted with the projection plan.
+ * @param p		Projection plan.
+ * @param field		Index of the field in the plan (starting at 0).
+ * @return		Type of the value (CHRONY_TYPE_NONE if the index is
+ * 			not valid).
+ */
+chrony_field_type chrony_get_projection_field_type(chrony_projection *p, int field);
+/**
+ * Extract the values of the fields selected by the projection plan from
+ * the requested record. Fields missing in the record (e.g. due to an older
+ * server) have the value of CHRONY_ABSENT_UINTEGER, NaN, zero, or an empty
+ * string.
+ * @param s		Session.
+ * @param p		Projection plan.
+ * @param values	Array of values with one value for each field in the
+ * 			plan.
+ * @return		Error code (CHRONY_OK on success, CHRONY_INVALID_ARGUMENT
+ * 			if the session does not have a record of the report).
+ */
+chrony_err chrony_project_record(chrony_session *s, chrony_projection *p,
+				 chrony_field_value *values);
+
+/**
+ * Joined records of the sources, sourcestats, selectdata and ntpdata reports
+ * of one source. The source is identified by the address, or the reference
+ * ID for reference clocks (which have an empty address). The selectdata
+ * record is missing with servers which don't support the report. The ntpdata
+ * record is missing for reference clocks and if the report is not allowed
+ * (e.g. over a UDP socket).
+ */
+typedef struct {
+	char address[CHRONY_MAX_ADDRESS_LEN];
+	uint64_t reference_id;
+	chrony_sources_record sources;
+	chrony_sourcestats_record sourcestats;
+	bool has_selectdata;
+	chrony_selectdata_record selectdata;
+	bool has_ntpdata;
+	chrony_ntpdata_record ntpdata;
+} chrony_source_row;
+
+/**
+ * Send requests for the joined records of all sources. The number of sources
+ * is requested once and the records are requested with multiple requests in
+ * flight. If the sources change during the scan (detected by a different
+ * number of sources at the end, an invalid index, or records of a different
+ * source), the scan is restarted. The responses are processed by
+ * chrony_process_response() until chrony_needs_response() returns false.
+ * Another request sent in the session cancels the scan.
+ * @param s		Session.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_request_source_rows(chrony_session *s);
+/**
+ * Get the number of joined source rows after a completed scan.
+ * @param s		Session.
+ * @return		Number of rows (0 if the scan was not completed).
+ */
+int chrony_get_number_source_rows(chrony_session *s);
+/**
+ * Get a joined source row.
+ * @param s		Session.
+ * @param row		Index of the row (starting at 0).
+ * @param r		Pointer to the row which should be filled.
+ * @return		Error code (CHRONY_OK on success, CHRONY_INVALID_ARGUMENT
+ * 			if the index is not valid).
+ */
+chrony_err chrony_get_source_row(chrony_session *s, int row, chrony_source_row *r);
+
+/**
+ * Type for a schedule of requests, which estimates when new data can be
+ * expected in the reports (e.g. after the next clock update for the tracking
+ * report, or after the next sample of a source for the reports with records
+ * of sources) in order to avoid requesting data which could not change.
+ */
+typedef struct chrony_schedule_t chrony_schedule;
+
+/**
+ * Create a new schedule.
+ * @param sch		Pointer to pointer where the new schedule should be
+ * 			saved.
+ * @param min_interval	Minimum interval between requests of a record (in
+ * 			seconds).
+ * @param max_interval	Maximum interval between requests of a record (in
+ * 			seconds), e.g. for reports which don't have an expected
+ * 			update interval and the number of sources.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_schedule(chrony_schedule **sch, double min_interval,
+				double max_interval);
+/**
+ * Destroy the schedule.
+ * @param sch		Schedule.
+ */
+void chrony_deinit_schedule(chrony_schedule *sch);
+/**
+ * Update the schedule after receiving the number of records, or a record,
+ * of a report in the session.
+ * @param sch		Schedule.
+ * @param s		Session.
+ * @param report_name	Name of the report.
+ * @param record	Index of the record, or -1 for the number of records.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_update_schedule(chrony_schedule *sch, chrony_session *s,
+				  const char *report_name, int record);
+/**
+ * Update the schedule after a completed scan of joined source rows
+ * (see chrony_request_source_rows()).
+ * @param sch		Schedule.
+ * @param s		Session.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_update_schedule_source_rows(chrony_schedule *sch, chrony_session *s);
+/**
+ * Check if a record, or the number of records, should be requested. Records
+ * which were not received yet are always due.
+ * @param sch		Schedule.
+ * @param report_name	Name of the report.
+ * @param record	Index of the record, or -1 for the number of records.
+ * @return		true if due, false otherwise.
+ */
+bool chrony_is_record_due(chrony_schedule *sch, const char *report_name, int record);
+/**
+ * Check if the joined source rows should be requested, i.e. the number of
+ * sources or a record of any source is due.
+ * @param sch		Schedule.
+ * @return		true if due, false otherwise.
+ */
+bool chrony_are_source_rows_due(chrony_schedule *sch);
+/**
+ * Get the time until the next record is due, e.g. for the timeout of
+ * poll() in the event loop of the application.
+ * @param sch		Schedule.
+ * @return		Time in seconds (zero if a record is already due, or
+ * 			nothing was scheduled yet).
+ */
+double chrony_get_schedule_timeout(chrony_schedule *sch);
+
+/**
+ * Type for a limiter of the rate of requests, which can be shared by
+ * multiple sessions (e.g. in different threads) using the same server.
+ * Requests exceeding the rate are queued in the sessions and sent later in
+ * chrony_process_response(). The rate is decreased when a new request is
+ * made before the response to the previous request was received (i.e. after
+ * a timeout) and slowly increased back with received responses.
+ */
+typedef struct chrony_limiter_t chrony_limiter;
+
+/**
+ * Create a new limiter.
+ * @param l		Pointer to pointer where the new limiter should be
+ * 			saved.
+ * @param rate		Maximum rate of requests (per second).
+ * @param burst		Maximum number of requests sent at once (at least 1).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_limiter(chrony_limiter **l, double rate, double burst);
+/**
+ * Destroy the limiter. It must not be used by any session.
+ * @param l		Limiter.
+ */
+void chrony_deinit_limiter(chrony_limiter *l);
+/**
+ * Get the current rate of the limiter, which is reduced after missing
+ * responses.
+ * @param l		Limiter.
+ * @return		Rate of requests (per second).
+ */
+double chrony_get_limiter_rate(chrony_limiter *l);
+/**
+ * Set the limiter of requests sent in the session.
+ * @param s		Session.
+ * @param l		Limiter, or NULL to send requests without limiting.
+ */
+void chrony_set_session_limiter(chrony_session *s, chrony_limiter *l);
+/**
+ * Get the time until a request queued by the limiter can be sent. If a
+ * request is queued, the application should call chrony_process_response()
+ * after the delay even if no response was received on the socket.
+ * @param s		Session.
+ * @return		Delay in seconds (zero if the request can be sent now),
+ * 			or a negative value if no request is queued.
+ */
+double chrony_get_send_delay(chrony_session *s);
+
+/**
+ * Type for a multiplexer of sessions with different servers sharing one
+ * unconnected UDP socket, e.g. to poll a large number of servers from one
+ * event loop without a socket for each server. Responses received from the
+ * shared socket are passed to the session matching the source address and
+ * sequence number of the response. The multiplexer and its sessions must
+ * not be used in multiple threads at the same time.
+ */
+typedef struct chrony_multiplexer_t chrony_multiplexer;
+
+/**
+ * Open an unconnected UDP socket for a multiplexer. The socket accepts both
+ * IPv4 and IPv6 addresses if IPv6 is supported by the system.
+ * @return		File descriptor of the socket, or a negative value on
+ * 			error.
+ */
+int chrony_open_multiplexer_socket(void);
+/**
+ * Create a new multiplexer.
+ * @param m		Pointer to pointer where the new multiplexer should be
+ * 			saved.
+ * @param fd		Socket returned by chrony_open_multiplexer_socket().
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_multiplexer(chrony_multiplexer **m, int fd);
+/**
+ * Destroy the multiplexer. All its sessions need to be destroyed first. The
+ * socket is not closed.
+ * @param m		Multiplexer.
+ */
+void chrony_deinit_multiplexer(chrony_multiplexer *m);
+/**
+ * Create a new session using the socket of the multiplexer. The responses
+ * are received by chrony_process_multiplexer(). chrony_process_response()
+ * should be called only to send a request queued by a limiter (see
+ * chrony_get_send_delay()).
+ * @param s		Pointer to pointer where the new session should
+ * 			be saved.
+ * @param m		Multiplexer.
+ * @param address	IPv4 or IPv6 address of the server in the form accepted
+ * 			by chrony_open_socket() (Unix domain sockets are not
+ * 			supported).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_multiplexed_session(chrony_session **s, chrony_multiplexer *m,
+					   const char *address);
+/**
+ * Receive a datagram waiting on the socket of the multiplexer and process it
+ * in the session to which it is a response, in the same way as
+ * chrony_process_response(). This function should be called when the socket
+ * is readable.
+ * @param m		Multiplexer.
+ * @param s		Pointer where the session which processed the response
+ * 			should be saved, or NULL if the datagram was not a
+ * 			response to any session waiting for a response.
+ * @return		Error code of the processing (CHRONY_OK on success).
+ */
+chrony_err chrony_process_multiplexer(chrony_multiplexer *m, chrony_session **s);
+
+/**
+ * Type for a session shared by multiple threads. Any thread can submit
+ * requests, which are queued without locking. One thread (the owner) makes
+ * the requests in the session one at a time and calls the callbacks of the
+ * requests with the results. This allows multiple threads to use one socket.
+ */
+typedef struct chrony_shared_session_t chrony_shared_session;
+
+/**
+ * Type for a callback of a request submitted to a shared session. It is
+ * called in the owner thread.
+ * @param s		Session with the result of the request, which is
+ * 			valid only in the callback (e.g. the number of records,
+ * 			or the record available for chrony_get_field_*()
+ * 			functions). No requests can be made in the session.
+ * @param err		Error code of the request (CHRONY_OK on success, or
+ * 			CHRONY_NO_RESPONSE on timeout or when the shared session
+ * 			is destroyed before completing the request).
+ * @param arg		Argument passed to chrony_submit_shared_request().
+ */
+typedef void (*chrony_shared_callback)(chrony_session *s, chrony_err err, void *arg);
+
+/**
+ * Create a new shared session.
+ * @param ss		Pointer to pointer where the new shared session should
+ * 			be saved.
+ * @param fd		Socket returned by chrony_open_socket().
+ * @param timeout	Timeout of requests (in seconds).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_shared_session(chrony_shared_session **ss, int fd, double timeout);
+/**
+ * Destroy the shared session. It must be called in the owner thread when
+ * no other thread can submit requests. The callbacks of uncompleted
+ * requests are called with CHRONY_NO_RESPONSE. The socket is not closed.
+ * @param ss		Shared session.
+ */
+void chrony_deinit_shared_session(chrony_shared_session *ss);
+/**
+ * Submit a request of a record, or the number of records, of a report. This
+ * function can be called in any thread.
+ * @param ss		Shared session.
+ * @param report_name	Name of the report.
+ * @param record	Index of the record, or -1 for the number of records.
+ * @param callback	Function called with the result in the owner thread.
+ * @param arg		Argument passed to the callback.
+ * @return		Error code (CHRONY_OK on success, CHRONY_QUEUE_FULL if
+ * 			the queue of requests is full and the request should
+ * 			be submitted again later).
+ */
+chrony_err chrony_submit_shared_request(chrony_shared_session *ss, const char *report_name,
+					int record, chrony_shared_callback callback, void *arg);
+/**
+ * Get the file descriptor which becomes readable when a request is
+ * submitted. The owner thread should call chrony_process_shared_session()
+ * when this descriptor or the socket of the session is readable, or the
+ * timeout from chrony_get_shared_session_timeout() expires.
+ * @param ss		Shared session.
+ * @return		File descriptor.
+ */
+int chrony_get_shared_session_fd(chrony_shared_session *ss);
+/**
+ * Get the time until the timeout of the request waiting for a response.
+ * @param ss		Shared session.
+ * @return		Time in seconds (zero if the timeout already expired),
+ * 			or a negative value if no request is waiting for a
+ * 			response.
+ */
+double chrony_get_shared_session_timeout(chrony_shared_session *ss);
+/**
+ * Process responses received on the socket, timeouts, and submitted
+ * requests, and call the callbacks of completed requests. This function
+ * can be called only in the owner thread.
+ * @param ss		Shared session.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_process_shared_session(chrony_shared_session *ss);
+
+/**
+ * Type for a poller of a fleet of servers with multiple worker threads,
+ * each running its own event loop with a number of sessions. Each worker
+ * has a queue of jobs and idle workers steal half of the pending jobs of
+ * the worker with the longest queue. A job requests all records of a report
+ * from one server in a new session. The results of jobs are passed to one
+ * consumer thread in a lock-free queue.
+ */
+typedef struct chrony_poller_t chrony_poller;
+
+/**
+ * Flag of the poller to disable stealing of jobs between workers.
+ */
+#define CHRONY_POLLER_NO_STEALING 0x1
+/**
+ * Flag of the poller to use one unconnected UDP socket in each worker for
+ * all its sessions (see chrony_init_multiplexer()).
+ */
+#define CHRONY_POLLER_MULTIPLEXING 0x2
+
+/**
+ * Result of a job of the poller.
+ */
+typedef struct {
+	/* Identifier of the job */
+	int id;
+	/* Index of the worker which completed the job */
+	int worker;
+	/* Number of requests sent in the job */
+	int requests;
+	/* The job timed out waiting for a response */
+	bool timeout;
+	/* Error code of the job (CHRONY_OK on success) */
+	chrony_err error;
+	/* Time from the start of the job to its completion (in seconds) */
+	double duration;
+} chrony_poller_result;
+
+/**
+ * Create a new poller and start its worker threads.
+ * @param p		Pointer to pointer where the new poller should be saved.
+ * @param report_name	Name of the report requested in the jobs.
+ * @param num_workers	Number of worker threads.
+ * @param max_active	Maximum number of active jobs in each worker.
+ * @param timeout	Timeout of requests (in seconds).
+ * @param flags		Flags of the poller (e.g. CHRONY_POLLER_NO_STEALING).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_poller(chrony_poller **p, const char *report_name, int num_workers,
+			      int max_active, double timeout, int flags);
+/**
+ * Stop the workers and destroy the poller. Jobs which are not completed are
+ * dropped without a result.
+ * @param p		Poller.
+ */
+void chrony_deinit_poller(chrony_poller *p);
+/**
+ * Add a job to the queue of a worker. This function can be called in any
+ * thread.
+ * @param p		Poller.
+ * @param address	Address of the server (see chrony_open_socket()). The
+ * 			string must be valid until the result of the job is
+ * 			taken by chrony_pop_poller_result().
+ * @param id		Identifier of the job passed in the result.
+ * @param worker	Index of the worker (e.g. to shard the servers between
+ * 			the workers), which may be stolen by another worker.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_add_poller_job(chrony_poller *p, const char *address, int id, int worker);
+/**
+ * Get the file descriptor which becomes readable when a result is available
+ * after chrony_pop_poller_result() returned false.
+ * @param p		Poller.
+ * @return		File descriptor.
+ */
+int chrony_get_poller_fd(chrony_poller *p);
+/**
+ * Take the next result from the queue. This function can be called only in
+ * one thread (the consumer). The results need to be taken continuously, the
+ * workers wait when the queue is full.
+ * @param p		Poller.
+ * @param result	Pointer to the result.
+ * @return		true if a result was taken, false if the queue is empty.
+ */
+bool chrony_pop_poller_result(chrony_poller *p, chrony_poller_result *result);
+/**
+ * Get the number of jobs stolen by a worker from other workers.
+ * @param p		Poller.
+ * @param worker	Index of the worker.
+ * @return		Number of stolen jobs.
+ */
+uint64_t chrony_get_poller_stolen_jobs(chrony_poller *p, int worker);
+
+/**
+ * Type for streaming statistics of the fields of records, e.g. to report
+ * a summary of the tracking or sourcestats records of one source in each
+ * interval instead of all records. Only fields with measurements are
+ * included (e.g. offsets, intervals and frequencies, but not counts, flags,
+ * or times). The memory used by each field is fixed (about 4 kB).
+ * Quantiles have a relative error smaller than 7%.
+ */
+typedef struct chrony_stats_t chrony_stats;
+
+/**
+ * Summary of the values of a field.
+ */
+typedef struct {
+	uint64_t count;
+	double min;
+	double max;
+	double mean;
+	/* Exponentially weighted moving average (not reset) */
+	double ewma;
+} chrony_stats_summary;
+
+/**
+ * Create new statistics.
+ * @param st		Pointer to pointer where the new statistics should be
+ * 			saved.
+ * @param ewma_weight	Weight of new values in the exponentially weighted
+ * 			moving average (between 0 and 1).
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_stats(chrony_stats **st, double ewma_weight);
+/**
+ * Destroy the statistics.
+ * @param st		Statistics.
+ */
+void chrony_deinit_stats(chrony_stats *st);
+/**
+ * Forget all values (except the moving average) to start a new interval.
+ * @param st		Statistics.
+ */
+void chrony_reset_stats(chrony_stats *st);
+/**
+ * Add the values of the fields of the requested record in the session.
+ * @param st		Statistics.
+ * @param s		Session.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_update_stats(chrony_stats *st, chrony_session *s);
+/**
+ * Add a value of a field, e.g. from a decoded record or a source row.
+ * @param st		Statistics.
+ * @param name		Name of the field.
+ * @param content	Content type of the field (must be a measurement).
+ * @param value		Value.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_add_stats_value(chrony_stats *st, const char *name,
+				  chrony_field_content content, double value);
+/**
+ * Get the number of fields with statistics.
+ * @param st		Statistics.
+ * @return		Number of fields.
+ */
+int chrony_get_stats_number_fields(chrony_stats *st);
+/**
+ * Get the name of a field with statistics.
+ * @param st		Statistics.
+ * @param field		Index of the field (starting at 0).
+ * @return		Name of the field, or NULL if the index is invalid.
+ */
+const char *chrony_get_stats_field_name(chrony_stats *st, int field);
+/**
+ * Get the content type of a field with statistics.
+ * @param st		Statistics.
+ * @param field		Index of the field (starting at 0).
+ * @return		Content type (CHRONY_CONTENT_NONE if the index is
+ * 			invalid).
+ */
+chrony_field_content chrony_get_stats_field_content(chrony_stats *st, int field);
+/**
+ * Get the summary of the values of a field.
+ * @param st		Statistics.
+ * @param field		Index of the field (starting at 0).
+ * @param summary	Pointer to the summary.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_get_stats_summary(chrony_stats *st, int field, chrony_stats_summary *summary);
+/**
+ * Estimate a quantile of the values of a field.
+ * @param st		Statistics.
+ * @param field		Index of the field (starting at 0).
+ * @param quantile	Quantile (e.g. 0.5 for the median, 0.99 for the 99th
+ * 			percentile).
+ * @return		Estimated value, or NaN if there are no values or the
+ * 			arguments are invalid.
+ */
+double chrony_get_stats_quantile(chrony_stats *st, int field, double quantile);
+
+/**
+ * Flag of the JSON encoding to write values of fields with a unit as objects
+ * with the value and unit, e.g. {"value":0.001,"unit":"s"}.
+ */
+#define CHRONY_JSON_UNITS 0x1
+
+struct iovec;
+
+/**
+ * Encode the requested record as a JSON object with the names of fields as
+ * keys. Reference IDs are hexadecimal strings, enums are the names of the
+ * values (numbers if unknown), flags are arrays of the names of set flags,
+ * times are numbers of seconds since the Unix epoch, and missing float
+ * values are null. Fields with no content type are plain numbers. Reserved
+ * fields and missing addresses are skipped. No memory is allocated.
+ * @param s		Session.
+ * @param flags		Flags of the encoding (e.g. CHRONY_JSON_UNITS).
+ * @param buf		Buffer for the output, which is terminated by a null
+ * 			character (truncated if it does not fit).
+ * @param size		Size of the buffer.
+ * @return		Length of the complete output (excluding the null
+ * 			character, like snprintf()), or a negative value if the
+ * 			session does not have a record.
+ */
+int chrony_format_record_json(chrony_session *s, int flags, char *buf, size_t size);
+/**
+ * Encode the requested record as a JSON object (in the same format as
+ * chrony_format_record_json()) into a list of chunks for writev() or
+ * sendmsg(). The names of fields and constants point to the tables of the
+ * library, which are not copied. Other data is written to a scratch buffer.
+ * @param s		Session.
+ * @param flags		Flags of the encoding (e.g. CHRONY_JSON_UNITS).
+ * @param iov		Array of chunks.
+ * @param max_iov	Size of the array.
+ * @param scratch	Scratch buffer (which needs to be kept until the chunks
+ * 			are written).
+ * @param scratch_size	Size of the scratch buffer.
+ * @return		Number of chunks, or a negative value if the session
+ * 			does not have a record, or the array or scratch buffer
+ * 			is too small.
+ */
+int chrony_format_record_json_iov(chrony_session *s, int flags, struct iovec *iov, int max_iov,
+				  char *scratch, size_t scratch_size);
+
+/**
+ * Type for a snapshot of a record, e.g. to find fields which changed
+ * since the previous request of the record.
+ */
+typedef struct chrony_snapshot_t chrony_snapshot;
+
+/**
+ * Create a new empty snapshot.
+ * @param snap		Pointer to pointer where the new snapshot should be
+ * 			saved.
+ * @return		Error code (CHRONY_OK on success).
+ */
+chrony_err chrony_init_snapshot(chrony_snapshot **snap);
+/**
+ * Destroy the snapshot.
+ * @param snap		Snapshot.
+ */
+void chrony_deinit_snapshot(chrony_snapshot *snap);
+/**
+ * Save the record received in the session to the snapshot.
+ * @param snap		Snapshot.
+ * @param s		Session.
+ * @return		Error code (CHRONY_OK on success, CHRONY_INVALID_ARGUMENT
+ * 			if the session does not have a record).
+ */
+chrony_err chrony_save_snapshot(chrony_snapshot *snap, chrony_session *s);
+/**
+ * Get the indices of fields which have different values in two snapshots.
+ * The records need to have the same fields (the same report and response
+ * of the server). Reserved fields are ignored.
+ * @param snap1		First snapshot.
+ * @param snap2		Second snapshot.
+ * @param fields	Array where the indices of the changed fields should
+ * 			be saved (in increasing order).
+ * @param max_fields	Maximum number of indices saved in the array.
+ * @return		Number of changed fields (which can be larger than
+ * 			max_fields), or -1 if the records don't have the same
+ * 			fields.
+ */
+int chrony_diff_snapshots(const chrony_snapshot *snap1, const chrony_snapshot *snap2,
+			  int *fields, int max_fields);
+/**
+ * Get the indices of fields of the record received in the session which
+ * have different values than in the snapshot, in the same way as
+ * chrony_diff_snapshots(). The values of the changed fields can be read by
+ * the chrony_get_field_*() functions.
+ * @param s		Session.
+ * @param snap		Snapshot of a previous record.
+ * @param fields	Array where the indices of the changed fields should
+ * 			be saved (in increasing order).
+ * @param max_fields	Maximum number of indices saved in the array.
+ * @return		Number of changed fields (which can be larger than
+ * 			max_fields), or -1 if the session does not have a record
+ * 			or the records don't have the same fields.
+ */
+int chrony_diff_record(chrony_session *s, const chrony_snapshot *snap,
+		       int *fields, int max_fields);
 
 #ifdef __cplusplus
 }
@@ -20,19 +20,87 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 typedef enum {
 	STATE_IDLE,
+	STATE_REQUEST_QUEUED,
 	STATE_REQUEST_SENT,
 	STATE_RESPONSE_RECEIVED,
 	STATE_RESPONSE_ACCEPTED,
+	STATE_VIEW_SCAN,
+	STATE_PROBE,
 } State;
 
+#define MAX_PIPELINED_REQUESTS 16
+#define MAX_VIEW_RESTARTS 3
+
+/* Reports joined in the source view */
+typedef enum {
+	VIEW_SOURCES,
+	VIEW_SOURCESTATS,
+	VIEW_SELECTDATA,
+	VIEW_NTPDATA,
+	VIEW_COUNT,
+	MAX_VIEW_REPORTS,
+} ViewReport;
+
+typedef struct {
+	Message msg;
+	ViewReport report;
+	int row;
+} PendingRequest;
+
+typedef struct {
+	chrony_source_row row;
+	/* Address from the sources record used in the ntpdata request */
+	char address[20];
+	/* Bitmask of received reports */
+	unsigned int received;
+} ViewRow;
+
+typedef struct {
+	int report_indices[MAX_VIEW_REPORTS];
+	bool supported[MAX_VIEW_REPORTS];
+	ViewRow *rows;
+	int num_rows;
+	int max_rows;
+	int num_complete_rows;
+	/* Next row for index-based and ntpdata requests */
+	int next_row;
+	ViewReport next_report;
+	int next_ntpdata_row;
+	bool rows_started;
+	bool count_sent;
+	int restarts;
+	PendingRequest pending[MAX_PIPELINED_REQUESTS];
+	int num_pending;
+} SourceView;
+
+/* Probe of the reports available in the session */
+typedef struct {
+	/* Headers of the requests waiting for a response */
+	char requests[MAX_REPORTS][REQUEST_HEADER_LEN];
+	bool pending[MAX_REPORTS];
+	int num_pending;
+	int next_report;
+} Probe;
+
+struct chrony_projection_t {
+	const Report *report;
+	int num_fields;
+	/* Fields resolved for each response variant of the report */
+	ProjectedField *fields;
+};
+
 struct chrony_session_t {
 	State state;
 	int fd;
@@ -40,13 +108,39 @@ struct chrony_session_t {
 	bool count_requested;
 	int requested_record;
 	const Response *expected_responses;
+	/* Responses of the server learned in the session for the count and
+	   record requests of each report, which are assumed to not change
+	   (e.g. with an upgrade of the server) for the lifetime of the session */
+	Schema schemas[MAX_REPORTS][2];
+	Schema *schema;
 	Message request_msg;
 	Message response_msg;
 	int num_records;
 	const char *follow_report;
-	FILE *urandom;
+	SourceView *view;
+	Probe *probe;
+	chrony_limiter *limiter;
+	/* Send time of the next request reserved in the limiter */
+	bool send_reserved;
+	double send_time;
+	/* Time when the last request was sent */
+	double last_send_time;
+	int capture_fd;
+	chrony_multiplexer *mux;
+	int mux_entry;
+	/* Datagram received by the multiplexer for the session */
+	const char *mux_msg;
+	int mux_msg_len;
 };
 
+/* /dev/urandom shared by all sessions to not have a file descriptor and
+   stdio buffer in each session */
+static pthread_mutex_t urandom_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *urandom;
+static int urandom_sessions;
+
+static chrony_err process_pipelined_response(chrony_session *s);
+
 const char *chrony_get_error_string(chrony_err e) {
 	static const char *strings[] = {
 		"Success",
@@ -64,8 +158,11 @@ const char *chrony_get_error_string(chrony_err e) {
 		"Unsupported server version (too old)",
 		"Unsupported server version (too new)",
 		"Invalid response",
+		"No response received",
+		"Failed to create pipe",
+		"Queue is full",
 	};
-	assert(CHRONY_INVALID_RESPONSE == 14);
+	assert(CHRONY_QUEUE_FULL == 17);
 
 	if (e < 0 || e >= sizeof (strings) / sizeof (strings[0]))
 		return "Unknown error";
@@ -73,6 +170,41 @@ const char *chrony_get_error_string(chrony_err e) {
 	return strings[e];
 }
 
+static bool open_urandom(void) {
+	bool r = true;
+
+	pthread_mutex_lock(&urandom_lock);
+
+	if (!urandom)
+		urandom = fopen("/dev/urandom", "r");
+
+	if (urandom)
+		urandom_sessions++;
+	else
+		r = false;
+
+	pthread_mutex_unlock(&urandom_lock);
+
+	return r;
+}
+
+static void close_urandom(void) {
+	pthread_mutex_lock(&urandom_lock);
+
+	if (--urandom_sessions == 0) {
+		fclose(urandom);
+		urandom = NULL;
+	}
+
+	pthread_mutex_unlock(&urandom_lock);
+}
+
+/* Get a random sequence number of a request (the stream is locked by stdio
+   for sessions in different threads) */
+static bool get_random_sequence(uint32_t *sequence) {
+	return fread(sequence, sizeof (*sequence), 1, urandom) == 1;
+}
+
 chrony_err chrony_init_session(chrony_session **s, int fd) {
 	chrony_session *session;
 
@@ -83,8 +215,9 @@ chrony_err chrony_init_session(chrony_session **s, int fd) {
 	memset(session, 0, sizeof (*session));
 	session->state = STATE_IDLE;
 	session->fd = fd;
-	session->urandom = fopen("/dev/urandom", "r");
-	if (!session->urandom) {
+	session->capture_fd = -1;
+
+	if (!open_urandom()) {
 		free(session);
 		return CHRONY_NO_RANDOM;
 	}
@@ -94,8 +227,33 @@ chrony_err chrony_init_session(chrony_session **s, int fd) {
 	return CHRONY_OK;
 }
 
+chrony_err chrony_init_multiplexed_session(chrony_session **s, chrony_multiplexer *m,
+					   const char *address) {
+	chrony_err r;
+
+	r = chrony_init_session(s, get_multiplexer_fd(m));
+	if (r != CHRONY_OK)
+		return r;
+
+	r = add_multiplexer_session(m, *s, address, &(*s)->mux_entry);
+	if (r != CHRONY_OK) {
+		chrony_deinit_session(*s);
+		return r;
+	}
+
+	(*s)->mux = m;
+
+	return CHRONY_OK;
+}
+
 void chrony_deinit_session(chrony_session *s) {
-	fclose(s->urandom);
+	if (s->mux)
+		remove_multiplexer_session(s->mux, s->mux_entry);
+	if (s->view)
+		free(s->view->rows);
+	free(s->view);
+	free(s->probe);
+	close_urandom();
 	free(s);
 }
 
@@ -103,32 +261,188 @@ int chrony_get_fd(chrony_session *s) {
 	return s->fd;
 }
 
+void chrony_set_session_capture(chrony_session *s, int fd) {
+	s->capture_fd = fd;
+}
+
+static void capture_message(chrony_session *s, const char *msg, int len) {
+	struct {
+		uint16_t len;
+		uint32_t sec;
+		uint32_t nsec;
+	} header;
+	char record[10 + MAX_MESSAGE_LEN];
+	struct timespec ts;
+
+	if (s->capture_fd < 0 || len < 0 || len > MAX_MESSAGE_LEN)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	header.len = htons(8 + len);
+	header.sec = htonl(ts.tv_sec);
+	header.nsec = htonl(ts.tv_nsec);
+
+	/* The header is packed in the record */
+	memcpy(record, &header.len, 2);
+	memcpy(record + 2, &header.sec, 4);
+	memcpy(record + 6, &header.nsec, 4);
+	memcpy(record + 10, msg, len);
+
+	/* Errors are ignored, the capture must not disrupt the session */
+	if (write(s->capture_fd, record, 10 + len) < 0)
+		return;
+}
+
+static int send_message(chrony_session *s, const char *msg, int len) {
+	if (s->mux)
+		return send_multiplexed_message(s->mux, s->mux_entry, msg, len);
+
+	return send(s->fd, msg, len, 0);
+}
+
+static int receive_message(chrony_session *s, char *buf, int size, int flags) {
+	int len;
+
+	if (!s->mux)
+		return recv(s->fd, buf, size, flags);
+
+	/* Only the datagram passed by the multiplexer can be received */
+	if (!s->mux_msg) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	len = s->mux_msg_len < size ? s->mux_msg_len : size;
+	memcpy(buf, s->mux_msg, len);
+	s->mux_msg = NULL;
+
+	return len;
+}
+
+static double get_monotonic_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void chrony_set_session_limiter(chrony_session *s, chrony_limiter *l) {
+	s->limiter = l;
+	s->send_reserved = false;
+}
+
+double chrony_get_send_delay(chrony_session *s) {
+	double delay;
+
+	if (!s->send_reserved ||
+	    (s->state != STATE_REQUEST_QUEUED && s->state != STATE_VIEW_SCAN))
+		return -1.0;
+
+	delay = s->send_time - get_monotonic_time();
+
+	return delay > 0.0 ? delay : 0.0;
+}
+
+/* Check if a request can be sent now, or it needs to wait for the limiter */
+static bool is_send_allowed(chrony_session *s) {
+	double now;
+
+	if (!s->limiter)
+		return true;
+
+	now = get_monotonic_time();
+
+	/* Keep the reservation until the request is sent */
+	if (!s->send_reserved) {
+		s->send_time = reserve_limiter_token(s->limiter, now);
+		s->send_reserved = true;
+	}
+
+	if (s->send_time > now)
+		return false;
+
+	s->send_reserved = false;
+	s->last_send_time = now;
+
+	return true;
+}
+
+/* A new request made before receiving the response to the previous request
+   indicates a timeout, possibly caused by a rate limit of the server */
+static void check_missing_response(chrony_session *s) {
+	if (!s->limiter)
+		return;
+
+	if (s->state == STATE_REQUEST_SENT ||
+	    (s->state == STATE_VIEW_SCAN && s->view->num_pending > 0) ||
+	    (s->state == STATE_PROBE && s->probe->num_pending > 0))
+		decrease_limiter_rate(s->limiter, s->last_send_time, get_monotonic_time());
+}
+
+static chrony_err transmit_request(chrony_session *s) {
+	if (send_message(s, s->request_msg.msg, s->request_msg.len) < 0) {
+		s->state = STATE_IDLE;
+		return CHRONY_SEND_FAILED;
+	}
+
+	capture_message(s, s->request_msg.msg, s->request_msg.len);
+
+	s->state = STATE_REQUEST_SENT;
+
+	return CHRONY_OK;
+}
+
 bool chrony_needs_response(chrony_session *s) {
-	return s->state == STATE_REQUEST_SENT;
+	return s->state == STATE_REQUEST_QUEUED || s->state == STATE_REQUEST_SENT ||
+		s->state == STATE_VIEW_SCAN || s->state == STATE_PROBE;
 }
 
 chrony_err chrony_process_response(chrony_session *s) {
 	chrony_err r;
 	int len;
 
+	if (s->state == STATE_VIEW_SCAN || s->state == STATE_PROBE)
+		return process_pipelined_response(s);
+
+	if (s->state == STATE_REQUEST_QUEUED) {
+		/* Drop late responses to previous requests */
+		while ((len = receive_message(s, s->response_msg.msg, sizeof (s->response_msg.msg),
+					      MSG_DONTWAIT)) >= 0)
+			capture_message(s, s->response_msg.msg, len);
+		if (!is_send_allowed(s))
+			return CHRONY_OK;
+		return transmit_request(s);
+	}
+
 	if (s->state != STATE_REQUEST_SENT)
 		return CHRONY_UNEXPECTED_CALL;
 
-	memset(&s->response_msg, 0, sizeof (s->response_msg));
+	/* The buffer is not cleared. The decoders don't read data past the
+	   received length, which is checked in is_response_valid() and
+	   process_response(). */
+	s->response_msg.len = 0;
+	s->response_msg.num_fields = 0;
+	s->response_msg.fields = NULL;
 
-	len = recv(s->fd, s->response_msg.msg, sizeof (s->response_msg.msg), 0);
+	len = receive_message(s, s->response_msg.msg, sizeof (s->response_msg.msg), 0);
 	if (len < 0)
 		return CHRONY_RECV_FAILED;
 
+	capture_message(s, s->response_msg.msg, len);
+
 	s->response_msg.len = len;
 
 	if (!is_response_valid(&s->request_msg, &s->response_msg))
 		/* Ignore the response */
 		return CHRONY_OK;
 
+	if (s->limiter)
+		increase_limiter_rate(s->limiter);
+
 	s->state = STATE_RESPONSE_RECEIVED;
 
-	r = process_response(&s->response_msg, s->expected_responses);
+	r = process_response(&s->response_msg, s->expected_responses, s->schema);
 	if (r != CHRONY_OK)
 		return r;
 
@@ -145,46 +459,112 @@ chrony_err chrony_process_response(chrony_session *s) {
 	return CHRONY_OK;
 }
 
-static chrony_err send_request(chrony_session *s, const Request *request,
-			       void **values, const Response *expected_responses) {
+/* Check if a datagram received by the multiplexer has the sequence number
+   of a request waiting for a response in the session */
+bool is_session_response(chrony_session *s, const char *msg, int len) {
+	int i;
+
+	if (len < REQUEST_HEADER_LEN)
+		return false;
+
+	if (s->state == STATE_REQUEST_SENT)
+		return memcmp(msg + 16, s->request_msg.msg + 8, 4) == 0;
+
+	if (s->state == STATE_VIEW_SCAN) {
+		for (i = 0; i < s->view->num_pending; i++) {
+			if (memcmp(msg + 16, s->view->pending[i].msg.msg + 8, 4) == 0)
+				return true;
+		}
+	}
+
+	if (s->state == STATE_PROBE) {
+		for (i = 0; i < MAX_REPORTS; i++) {
+			if (s->probe->pending[i] && memcmp(msg + 16, s->probe->requests[i] + 8, 4) == 0)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+chrony_err process_multiplexed_message(chrony_session *s, const char *msg, int len) {
+	chrony_err r;
+
+	s->mux_msg = msg;
+	s->mux_msg_len = len;
+
+	r = chrony_process_response(s);
+
+	s->mux_msg = NULL;
+
+	return r;
+}
+
+static Schema *get_schema(chrony_session *s, int report, bool count) {
+	return &s->schemas[report][count ? 0 : 1];
+}
+
+static chrony_err send_request(chrony_session *s, const RequestTemplate *request,
+			       const Schema *schema, void **values) {
 	uint32_t sequence;
 
-	if (fread(&sequence, sizeof (sequence), 1, s->urandom) != 1) {
+	if (!get_random_sequence(&sequence)) {
 		s->state = STATE_IDLE;
 		return CHRONY_RANDOM_FAILED;
 	}
 
-	format_request(&s->request_msg, sequence, request, values, expected_responses);
+	format_request(&s->request_msg, sequence, request, values);
+	s->request_msg.len = get_request_len(request, schema);
 
-	if (send(s->fd, s->request_msg.msg, s->request_msg.len, 0) < 0) {
-		s->state = STATE_IDLE;
-		return CHRONY_SEND_FAILED;
+	check_missing_response(s);
+
+	if (!is_send_allowed(s)) {
+		s->state = STATE_REQUEST_QUEUED;
+		return CHRONY_OK;
 	}
 
-	s->state = STATE_REQUEST_SENT;
+	return transmit_request(s);
+}
 
-	return CHRONY_OK;
+/* Don't wait for a response to a previous request */
+static void cancel_request(chrony_session *s) {
+	if (s->state == STATE_REQUEST_SENT || s->state == STATE_REQUEST_QUEUED) {
+		check_missing_response(s);
+		s->state = STATE_IDLE;
+	}
 }
 
 chrony_err chrony_request_report_number_records(chrony_session *s, const char *report_name) {
 	const Report *report;
+	Schema *schema;
+	int report_index;
 	chrony_err r;
 
-	report = get_report(get_report_index(report_name));
+	report_index = get_report_index(report_name);
+	report = get_report(report_index);
 	if (!report)
 		return CHRONY_UNKNOWN_REPORT;
 
 	if (report->count_requests[0].code == 0) {
+		cancel_request(s);
 		s->num_records = 1;
 		return CHRONY_OK;
 	}
 
-	r = send_request(s, &report->count_requests[0], NULL, report->count_responses);
+	/* Don't repeat requests rejected by the server */
+	schema = get_schema(s, report_index, true);
+	if (schema->rejected != CHRONY_OK) {
+		cancel_request(s);
+		return schema->rejected;
+	}
+
+	r = send_request(s, get_request_template(report_index, true), schema, NULL);
 	if (r != CHRONY_OK)
 		return r;
 
 	s->num_expected_responses = 1;
 	s->expected_responses = report->count_responses;
+	s->schema = schema;
 	s->count_requested = true;
 
 	s->num_records = 0;
@@ -201,14 +581,28 @@ chrony_err chrony_request_record(chrony_session *s, const char *report_name, int
 	uint32_t index = record;
 	const Report *report;
 	const Field *fields;
+	Schema *schema;
+	int report_index;
 	chrony_err r;
 
 	s->follow_report = NULL;
 again:
-	report = get_report(get_report_index(report_name));
+	report_index = get_report_index(report_name);
+	report = get_report(report_index);
 	if (!report)
 		return CHRONY_UNKNOWN_REPORT;
 
+	/* Don't repeat requests rejected by the server, including the request
+	   of the address in the sourcestats report */
+	schema = get_schema(s, report_index, false);
+	if (schema->rejected != CHRONY_OK) {
+		cancel_request(s);
+		s->follow_report = NULL;
+		s->response_msg.num_fields = 0;
+		s->response_msg.fields = NULL;
+		return schema->rejected;
+	}
+
 	fields = report->record_requests[0].fields;
 
 	if (fields) {
@@ -241,12 +635,13 @@ again:
 			return CHRONY_INVALID_ARGUMENT;
 	}
 
-	r = send_request(s, &report->record_requests[0], args, report->record_responses);
+	r = send_request(s, get_request_template(report_index, false), schema, args);
 	if (r != CHRONY_OK)
 		return r;
 
 	s->num_expected_responses = 1;
 	s->expected_responses = report->record_responses;
+	s->schema = schema;
 	s->count_requested = false;
 	s->requested_record = record;
 
@@ -272,33 +667,22 @@ int chrony_get_field_index(chrony_session *s, const char *name) {
 }
 
 chrony_field_type chrony_get_field_type(chrony_session *s, int field) {
-	switch (resolve_field_type(&s->response_msg, field)) {
-	case TYPE_UINT64:
-	case TYPE_UINT32:
-	case TYPE_UINT16:
-	case TYPE_UINT8:
-		return CHRONY_TYPE_UINTEGER;
-	case TYPE_INT16:
-	case TYPE_INT8:
-		return CHRONY_TYPE_INTEGER;
-	case TYPE_FLOAT:
-		return CHRONY_TYPE_FLOAT;
-	case TYPE_ADDRESS:
-		return CHRONY_TYPE_STRING;
-	case TYPE_TIMESPEC:
-		return CHRONY_TYPE_TIMESPEC;
-	case TYPE_NONE:
-		return CHRONY_TYPE_NONE;
-	default:
-		assert(0);
-		return CHRONY_TYPE_NONE;
-	}
+	return get_value_type(resolve_field_type(&s->response_msg, field));
 }
 
 chrony_field_content chrony_get_field_content(chrony_session *s, int field) {
 	return resolve_field_content(&s->response_msg, field);
 }
 
+bool chrony_is_field_reserved(chrony_session *s, int field) {
+	const Message *msg = &s->response_msg;
+
+	if (!msg->fields || field < 0 || field >= msg->num_fields)
+		return false;
+
+	return msg->fields[field].reserved;
+}
+
 uint64_t chrony_get_field_uinteger(chrony_session *s, int field) {
 	return get_field_uinteger(&s->response_msg, field);
 }
@@ -322,3 +706,715 @@ const char *chrony_get_field_string(chrony_session *s, int field) {
 const char *chrony_get_field_constant_name(chrony_session *s, int field, uint64_t value) {
 	return get_field_constant_name(&s->response_msg, field, value);
 }
+
+int chrony_get_field_flag_names(chrony_session *s, int field, uint64_t value,
+				const char **names, int max_names) {
+	return get_field_flag_names(&s->response_msg, field, value, names, max_names);
+}
+
+chrony_err chrony_get_tracking_record(chrony_session *s, chrony_tracking_record *record) {
+	return decode_tracking_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_sources_record(chrony_session *s, chrony_sources_record *record) {
+	return decode_sources_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_sourcestats_record(chrony_session *s, chrony_sourcestats_record *record) {
+	return decode_sourcestats_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_selectdata_record(chrony_session *s, chrony_selectdata_record *record) {
+	return decode_selectdata_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_activity_record(chrony_session *s, chrony_activity_record *record) {
+	return decode_activity_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_authdata_record(chrony_session *s, chrony_authdata_record *record) {
+	return decode_authdata_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_ntpdata_record(chrony_session *s, chrony_ntpdata_record *record) {
+	return decode_ntpdata_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_serverstats_record(chrony_session *s, chrony_serverstats_record *record) {
+	return decode_serverstats_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_rtcdata_record(chrony_session *s, chrony_rtcdata_record *record) {
+	return decode_rtcdata_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_get_smoothing_record(chrony_session *s, chrony_smoothing_record *record) {
+	return decode_smoothing_record(&s->response_msg, record) ? CHRONY_OK : CHRONY_INVALID_ARGUMENT;
+}
+
+chrony_err chrony_init_projection(chrony_projection **p, const char *report_name,
+				  const char *const *field_names, int num_fields) {
+	const Report *report;
+	chrony_field_type type;
+	ProjectedField *fields;
+	int i, j;
+
+	report = get_report(get_report_index(report_name));
+	if (!report)
+		return CHRONY_UNKNOWN_REPORT;
+
+	if (num_fields < 0)
+		return CHRONY_INVALID_ARGUMENT;
+
+	*p = malloc(sizeof (**p));
+	if (!*p)
+		return CHRONY_NO_MEMORY;
+
+	fields = calloc(MAX_RESPONSES * num_fields + 1, sizeof (*fields));
+	if (!fields) {
+		free(*p);
+		return CHRONY_NO_MEMORY;
+	}
+
+	(*p)->report = report;
+	(*p)->num_fields = num_fields;
+	(*p)->fields = fields;
+
+	for (j = 0; j < num_fields; j++) {
+		type = CHRONY_TYPE_NONE;
+
+		for (i = 0; i < MAX_RESPONSES && report->record_responses[i].fields; i++) {
+			if (resolve_projected_field(report->record_responses[i].fields,
+						    field_names[j], &fields[i * num_fields + j]))
+				type = fields[i * num_fields + j].value_type;
+		}
+
+		if (type == CHRONY_TYPE_NONE) {
+			chrony_deinit_projection(*p);
+			return CHRONY_INVALID_ARGUMENT;
+		}
+
+		/* Missing fields need the type for the absent value */
+		for (i = 0; i < MAX_RESPONSES; i++)
+			fields[i * num_fields + j].value_type = type;
+	}
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_projection(chrony_projection *p) {
+	free(p->fields);
+	free(p);
+}
+
+chrony_field_type chrony_get_projection_field_type(chrony_projection *p, int field) {
+	if (field < 0 || field >= p->num_fields)
+		return CHRONY_TYPE_NONE;
+
+	return p->fields[field].value_type;
+}
+
+const Message *get_session_record(chrony_session *s) {
+	if (s->state != STATE_RESPONSE_ACCEPTED || !s->response_msg.fields)
+		return NULL;
+
+	return &s->response_msg;
+}
+
+chrony_err chrony_project_record(chrony_session *s, chrony_projection *p,
+				 chrony_field_value *values) {
+	int i;
+
+	if (!s->response_msg.fields)
+		return CHRONY_INVALID_ARGUMENT;
+
+	for (i = 0; i < MAX_RESPONSES; i++) {
+		if (p->report->record_responses[i].fields == s->response_msg.fields) {
+			project_fields(&s->response_msg, &p->fields[i * p->num_fields],
+				       p->num_fields, values);
+			return CHRONY_OK;
+		}
+	}
+
+	return CHRONY_INVALID_ARGUMENT;
+}
+
+static chrony_err send_view_request(chrony_session *s, ViewReport report, int row) {
+	const RequestTemplate *request;
+	SourceView *v = s->view;
+	void *args[1] = { NULL };
+	PendingRequest *pending;
+	uint32_t sequence, index = row;
+
+	assert(v->num_pending < MAX_PIPELINED_REQUESTS);
+	pending = &v->pending[v->num_pending];
+
+	if (!get_random_sequence(&sequence))
+		return CHRONY_RANDOM_FAILED;
+
+	switch (report) {
+	case VIEW_COUNT:
+		break;
+	case VIEW_NTPDATA:
+		args[0] = v->rows[row].address;
+		break;
+	default:
+		args[0] = &index;
+		break;
+	}
+
+	request = get_request_template(v->report_indices[report], report == VIEW_COUNT);
+	format_request(&pending->msg, sequence, request, args);
+	pending->msg.len = get_request_len(request, get_schema(s, v->report_indices[report],
+								report == VIEW_COUNT));
+
+	if (send_message(s, pending->msg.msg, pending->msg.len) < 0)
+		return CHRONY_SEND_FAILED;
+
+	capture_message(s, pending->msg.msg, pending->msg.len);
+
+	pending->report = report;
+	pending->row = row;
+	v->num_pending++;
+
+	return CHRONY_OK;
+}
+
+static void restart_view(chrony_session *s) {
+	SourceView *v = s->view;
+
+	/* Responses to the pending requests will be ignored and the number
+	   of sources requested again in send_view_requests() */
+	v->num_pending = 0;
+	v->num_rows = 0;
+	v->rows_started = false;
+	v->count_sent = false;
+}
+
+static chrony_err start_view_rows(chrony_session *s, int num_rows) {
+	SourceView *v = s->view;
+	ViewRow *rows;
+
+	if (num_rows > v->max_rows) {
+		rows = realloc(v->rows, num_rows * sizeof (*rows));
+		if (!rows)
+			return CHRONY_NO_MEMORY;
+		v->rows = rows;
+		v->max_rows = num_rows;
+	}
+
+	memset(v->rows, 0, num_rows * sizeof (*v->rows));
+	v->num_rows = num_rows;
+	v->num_complete_rows = 0;
+	v->next_row = 0;
+	v->next_report = VIEW_SOURCES;
+	v->next_ntpdata_row = 0;
+	v->rows_started = true;
+	v->count_sent = false;
+
+	return CHRONY_OK;
+}
+
+static bool is_view_row_complete(SourceView *v, ViewRow *row) {
+	ViewReport report;
+
+	if (!(row->received & (1U << VIEW_SOURCES)))
+		return false;
+
+	for (report = VIEW_SOURCESTATS; report <= VIEW_NTPDATA; report++) {
+		if (!v->supported[report] || row->received & (1U << report))
+			continue;
+		/* Reference clocks don't have ntpdata */
+		if (report == VIEW_NTPDATA && row->row.sources.mode == 2)
+			continue;
+		return false;
+	}
+
+	return true;
+}
+
+static void update_view_rows(SourceView *v) {
+	int i;
+
+	for (i = 0, v->num_complete_rows = 0; i < v->num_rows; i++) {
+		v->rows[i].row.has_selectdata = v->rows[i].received & (1U << VIEW_SELECTDATA);
+		v->rows[i].row.has_ntpdata = v->rows[i].received & (1U << VIEW_NTPDATA);
+		if (is_view_row_complete(v, &v->rows[i]))
+			v->num_complete_rows++;
+	}
+}
+
+static void advance_view_index(SourceView *v) {
+	if (++v->next_report == VIEW_NTPDATA) {
+		v->next_report = VIEW_SOURCES;
+		v->next_row++;
+	}
+}
+
+/* Find the next request of the scan without sending it */
+static bool get_next_view_request(SourceView *v, ViewReport *report, int *row) {
+	ViewRow *r;
+
+	/* The number of sources is needed first */
+	if (!v->rows_started) {
+		if (v->count_sent)
+			return false;
+		*report = VIEW_COUNT;
+		*row = 0;
+		return true;
+	}
+
+	/* The ntpdata request needs the address from the sources record */
+	while (v->next_ntpdata_row < v->num_rows) {
+		r = &v->rows[v->next_ntpdata_row];
+		if (!(r->received & (1U << VIEW_SOURCES)))
+			break;
+		if (v->supported[VIEW_NTPDATA] && r->row.sources.mode != 2) {
+			*report = VIEW_NTPDATA;
+			*row = v->next_ntpdata_row;
+			return true;
+		}
+		v->next_ntpdata_row++;
+	}
+
+	while (v->next_row < v->num_rows) {
+		if (v->supported[v->next_report]) {
+			*report = v->next_report;
+			*row = v->next_row;
+			return true;
+		}
+		advance_view_index(v);
+	}
+
+	/* Check the number of sources again at the end of the scan */
+	if (v->num_pending == 0 && v->num_complete_rows == v->num_rows && !v->count_sent) {
+		*report = VIEW_COUNT;
+		*row = 0;
+		return true;
+	}
+
+	return false;
+}
+
+/* Fill the pipeline with requests for the rows of the view */
+static chrony_err send_view_requests(chrony_session *s) {
+	SourceView *v = s->view;
+	ViewReport report;
+	chrony_err r;
+	int row;
+
+	while (v->num_pending < MAX_PIPELINED_REQUESTS && get_next_view_request(v, &report, &row)) {
+		/* Requests delayed by the limiter are sent in a later call */
+		if (!is_send_allowed(s))
+			break;
+
+		r = send_view_request(s, report, row);
+		if (r != CHRONY_OK)
+			return r;
+
+		switch (report) {
+		case VIEW_COUNT:
+			v->count_sent = true;
+			break;
+		case VIEW_NTPDATA:
+			v->next_ntpdata_row++;
+			break;
+		default:
+			advance_view_index(v);
+			break;
+		}
+	}
+
+	return CHRONY_OK;
+}
+
+/* Check that the records of a row are for the same source */
+static bool is_view_row_consistent(const ViewRow *row, ViewReport report) {
+	const chrony_source_row *r = &row->row;
+	uint64_t reference_id;
+	const char *address;
+
+	if (!(row->received & (1U << VIEW_SOURCES)))
+		return true;
+
+	switch (report) {
+	case VIEW_SOURCESTATS:
+		reference_id = r->sourcestats.reference_id;
+		address = r->sourcestats.address;
+		break;
+	case VIEW_SELECTDATA:
+		reference_id = r->selectdata.reference_id;
+		address = r->selectdata.address;
+		break;
+	default:
+		return true;
+	}
+
+	if (!(row->received & (1U << report)))
+		return true;
+
+	if (r->sources.mode == 2)
+		return reference_id == r->sources.reference_id;
+
+	return strcmp(address, r->sources.address) == 0;
+}
+
+static chrony_err process_view_count(chrony_session *s) {
+	SourceView *v = s->view;
+	int num_rows;
+
+	num_rows = get_field_uinteger(&s->response_msg, 0);
+
+	if (!v->rows_started)
+		return start_view_rows(s, num_rows);
+
+	if (num_rows == v->num_rows) {
+		update_view_rows(v);
+		s->state = STATE_IDLE;
+		return CHRONY_OK;
+	}
+
+	/* The sources changed during the scan */
+	if (++v->restarts > MAX_VIEW_RESTARTS)
+		return CHRONY_UNEXPECTED_STATUS;
+
+	restart_view(s);
+
+	return CHRONY_OK;
+}
+
+static chrony_err process_view_record(chrony_session *s, const PendingRequest *pending) {
+	SourceView *v = s->view;
+	ViewRow *row = &v->rows[pending->row];
+	chrony_source_row *r = &row->row;
+
+	switch (pending->report) {
+	case VIEW_SOURCES:
+		decode_sources_record(&s->response_msg, &r->sources);
+		memcpy(row->address, s->response_msg.msg + RESPONSE_HEADER_LEN, sizeof (row->address));
+		snprintf(r->address, sizeof (r->address), "%s", r->sources.address);
+		break;
+	case VIEW_SOURCESTATS:
+		decode_sourcestats_record(&s->response_msg, &r->sourcestats);
+		break;
+	case VIEW_SELECTDATA:
+		decode_selectdata_record(&s->response_msg, &r->selectdata);
+		break;
+	case VIEW_NTPDATA:
+		decode_ntpdata_record(&s->response_msg, &r->ntpdata);
+		break;
+	default:
+		assert(0);
+	}
+
+	row->received |= 1U << pending->report;
+
+	/* Joined records of different sources indicate changed sources */
+	if (!is_view_row_consistent(row, VIEW_SOURCESTATS) ||
+	    !is_view_row_consistent(row, VIEW_SELECTDATA)) {
+		if (++v->restarts > MAX_VIEW_RESTARTS)
+			return CHRONY_UNEXPECTED_STATUS;
+		restart_view(s);
+		return CHRONY_OK;
+	}
+
+	/* The reference ID of NTP sources is in the sourcestats record */
+	if (row->received & (1U << VIEW_SOURCES))
+		r->reference_id = r->sources.mode == 2 ? r->sources.reference_id :
+			row->received & (1U << VIEW_SOURCESTATS) ? r->sourcestats.reference_id :
+			CHRONY_ABSENT_UINTEGER;
+
+	if (is_view_row_complete(v, row))
+		v->num_complete_rows++;
+
+	return CHRONY_OK;
+}
+
+static chrony_err process_view_message(chrony_session *s) {
+	SourceView *v = s->view;
+	PendingRequest pending;
+	const Report *report;
+	chrony_err r;
+	bool count;
+	int i;
+
+	for (i = 0; i < v->num_pending; i++) {
+		if (is_response_valid(&v->pending[i].msg, &s->response_msg))
+			break;
+	}
+
+	/* Ignore unknown and late responses */
+	if (i >= v->num_pending)
+		return CHRONY_OK;
+
+	pending = v->pending[i];
+	v->pending[i] = v->pending[--v->num_pending];
+
+	if (s->limiter)
+		increase_limiter_rate(s->limiter);
+
+	count = pending.report == VIEW_COUNT;
+	report = get_report(v->report_indices[pending.report]);
+
+	r = process_response(&s->response_msg,
+			     count ? report->count_responses : report->record_responses,
+			     get_schema(s, v->report_indices[pending.report], count));
+
+	switch (r) {
+	case CHRONY_OK:
+		if (pending.report == VIEW_COUNT)
+			r = process_view_count(s);
+		else
+			r = process_view_record(s, &pending);
+		break;
+	case CHRONY_OLD_SERVER:
+	case CHRONY_UNAUTHORIZED:
+	case CHRONY_DISABLED:
+		/* The optional reports are left out if not supported or allowed */
+		if (pending.report == VIEW_SELECTDATA || pending.report == VIEW_NTPDATA) {
+			if (v->supported[pending.report]) {
+				v->supported[pending.report] = false;
+				update_view_rows(v);
+			}
+			r = CHRONY_OK;
+		}
+		break;
+	case CHRONY_UNEXPECTED_STATUS:
+		/* An invalid index (or address) indicates removed sources */
+		if (pending.report != VIEW_COUNT && ++v->restarts <= MAX_VIEW_RESTARTS) {
+			restart_view(s);
+			r = CHRONY_OK;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return r;
+}
+
+static chrony_err process_probe_message(chrony_session *s);
+static chrony_err send_probe_requests(chrony_session *s);
+
+/* Process a response in a source view scan or probe of reports, which
+   have multiple requests in flight */
+static chrony_err process_pipelined_response(chrony_session *s) {
+	chrony_err r;
+	int len;
+
+	s->response_msg.len = 0;
+	s->response_msg.num_fields = 0;
+	s->response_msg.fields = NULL;
+
+	len = receive_message(s, s->response_msg.msg, sizeof (s->response_msg.msg),
+			      MSG_DONTWAIT);
+	if (len >= 0) {
+		capture_message(s, s->response_msg.msg, len);
+		s->response_msg.len = len;
+		r = s->state == STATE_VIEW_SCAN ? process_view_message(s) : process_probe_message(s);
+	} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		/* No response, but requests delayed by the limiter may be sent */
+		r = CHRONY_OK;
+	} else {
+		r = CHRONY_RECV_FAILED;
+	}
+
+	if (r == CHRONY_OK && s->state == STATE_VIEW_SCAN)
+		r = send_view_requests(s);
+	else if (r == CHRONY_OK && s->state == STATE_PROBE)
+		r = send_probe_requests(s);
+
+	if (r != CHRONY_OK)
+		s->state = STATE_IDLE;
+
+	return r;
+}
+
+chrony_err chrony_request_source_rows(chrony_session *s) {
+	static const char *report_names[MAX_VIEW_REPORTS] = {
+		"sources", "sourcestats", "selectdata", "ntpdata", "sources"
+	};
+	SourceView *v;
+	chrony_err r;
+	int i;
+
+	if (!s->view) {
+		s->view = calloc(1, sizeof (*s->view));
+		if (!s->view)
+			return CHRONY_NO_MEMORY;
+	}
+
+	v = s->view;
+
+	for (i = 0; i < MAX_VIEW_REPORTS; i++) {
+		v->report_indices[i] = get_report_index(report_names[i]);
+		assert(v->report_indices[i] >= 0);
+		v->supported[i] = true;
+	}
+
+	/* Leave out the optional reports rejected by the server before */
+	for (i = VIEW_SELECTDATA; i <= VIEW_NTPDATA; i++)
+		v->supported[i] = get_schema(s, v->report_indices[i], false)->rejected == CHRONY_OK;
+
+	v->restarts = 0;
+	v->num_complete_rows = 0;
+
+	check_missing_response(s);
+
+	s->follow_report = NULL;
+	s->state = STATE_VIEW_SCAN;
+
+	restart_view(s);
+
+	r = send_view_requests(s);
+	if (r != CHRONY_OK)
+		s->state = STATE_IDLE;
+
+	return r;
+}
+
+int chrony_get_number_source_rows(chrony_session *s) {
+	if (!s->view || s->state == STATE_VIEW_SCAN)
+		return 0;
+
+	return s->view->num_complete_rows == s->view->num_rows ? s->view->num_rows : 0;
+}
+
+chrony_err chrony_get_source_row(chrony_session *s, int row, chrony_source_row *r) {
+	if (row < 0 || row >= chrony_get_number_source_rows(s))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*r = s->view->rows[row].row;
+
+	return CHRONY_OK;
+}
+
+static chrony_err send_probe_requests(chrony_session *s) {
+	const RequestTemplate *request;
+	const Field *fields;
+	Probe *p = s->probe;
+	uint32_t sequence, index = 0;
+	/* Unspecified address */
+	char address[20] = { 0 };
+	void *args[1];
+	int report;
+
+	while (p->num_pending < MAX_PIPELINED_REQUESTS &&
+	       p->next_report < chrony_get_number_supported_reports()) {
+		/* Requests delayed by the limiter are sent in a later call */
+		if (!is_send_allowed(s))
+			break;
+
+		if (!get_random_sequence(&sequence))
+			return CHRONY_RANDOM_FAILED;
+
+		/* The index or address doesn't need to be valid. The server checks
+		   if the request is allowed before processing it. */
+		report = p->next_report;
+		fields = get_report(report)->record_requests[0].fields;
+		args[0] = fields && fields[0].type == TYPE_ADDRESS ? (void *)address : (void *)&index;
+
+		request = get_request_template(report, false);
+		format_request(&s->request_msg, sequence, request, args);
+		s->request_msg.len = get_request_len(request, get_schema(s, report, false));
+
+		if (send_message(s, s->request_msg.msg, s->request_msg.len) < 0)
+			return CHRONY_SEND_FAILED;
+
+		capture_message(s, s->request_msg.msg, s->request_msg.len);
+
+		memcpy(p->requests[report], s->request_msg.msg, REQUEST_HEADER_LEN);
+		p->pending[report] = true;
+		p->num_pending++;
+		p->next_report++;
+	}
+
+	if (p->num_pending == 0 && p->next_report >= chrony_get_number_supported_reports())
+		s->state = STATE_IDLE;
+
+	return CHRONY_OK;
+}
+
+static chrony_err process_probe_message(chrony_session *s) {
+	Probe *p = s->probe;
+	int i;
+
+	for (i = 0; i < p->next_report; i++) {
+		if (p->pending[i] && is_response_header_valid(p->requests[i], &s->response_msg))
+			break;
+	}
+
+	/* Ignore unknown and late responses */
+	if (i >= p->next_report)
+		return CHRONY_OK;
+
+	p->pending[i] = false;
+	p->num_pending--;
+
+	if (s->limiter)
+		increase_limiter_rate(s->limiter);
+
+	/* The result is saved in the schema of the request */
+	process_response(&s->response_msg, get_report(i)->record_responses,
+			 get_schema(s, i, false));
+
+	s->response_msg.num_fields = 0;
+	s->response_msg.fields = NULL;
+
+	return CHRONY_OK;
+}
+
+chrony_err chrony_probe_reports(chrony_session *s) {
+	chrony_err r;
+	int i;
+
+	if (!s->probe) {
+		s->probe = calloc(1, sizeof (*s->probe));
+		if (!s->probe)
+			return CHRONY_NO_MEMORY;
+	}
+
+	memset(s->probe, 0, sizeof (*s->probe));
+
+	/* Only the records are probed. Allow requests of the number of records
+	   rejected before to be sent again. */
+	for (i = 0; i < chrony_get_number_supported_reports(); i++)
+		get_schema(s, i, true)->rejected = CHRONY_OK;
+
+	check_missing_response(s);
+
+	s->follow_report = NULL;
+	s->state = STATE_PROBE;
+
+	r = send_probe_requests(s);
+	if (r != CHRONY_OK)
+		s->state = STATE_IDLE;
+
+	return r;
+}
+
+chrony_err chrony_get_report_availability(chrony_session *s, const char *report_name) {
+	const Schema *schema;
+	int report_index;
+
+	report_index = get_report_index(report_name);
+	if (!get_report(report_index))
+		return CHRONY_UNKNOWN_REPORT;
+
+	schema = get_schema(s, report_index, false);
+	if (schema->rejected != CHRONY_OK)
+		return schema->rejected;
+
+	return schema->accepted ? CHRONY_OK : CHRONY_UNEXPECTED_CALL;
+}
+
+void chrony_reset_report_availability(chrony_session *s) {
+	int i, j;
+
+	for (i = 0; i < MAX_REPORTS; i++) {
+		for (j = 0; j < 2; j++) {
+			s->schemas[i][j].accepted = false;
+			s->schemas[i][j].rejected = CHRONY_OK;
+		}
+	}
+}
@@ -18,9 +18,11 @@
 
 #include "chrony.h"
 
+#include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
 #include <stdio.h>
+#include <unistd.h>
 
 static chrony_err process_responses(chrony_session *s) {
 	struct pollfd pfd = { .fd = chrony_get_fd(s), .events = POLLIN };
@@ -64,11 +66,11 @@ static chrony_err process_responses(chrony_session *s) {
 
 static int print_report(chrony_session *s, int report_index) {
 	chrony_field_content content;
-	const char *report_name, *str;
-	uint64_t uval, flag;
+	const char *report_name, *str, *flags[64];
 	struct timespec ts;
+	int i, j, k, n;
+	uint64_t uval;
 	chrony_err r;
-	int i, j;
 
 	report_name = chrony_get_report_name(report_index);
 	printf("%s:\n", report_name);
@@ -112,13 +114,9 @@ static int print_report(chrony_session *s, int report_index) {
 						printf("%s", str);
 					break;
 				case CHRONY_CONTENT_FLAGS:
-					for (flag = 1; flag != 0; flag <<= 1) {
-						if ((uval & flag) == 0)
-							continue;
-						str = chrony_get_field_constant_name(s, j, flag);
-						if (str)
-							printf("%s ", str);
-					}
+					n = chrony_get_field_flag_names(s, j, uval, flags, 64);
+					for (k = 0; k < n; k++)
+						printf("%s ", flags[k]);
 					break;
 				case CHRONY_CONTENT_BOOLEAN:
 					printf(uval ? "Yes" : "No");
@@ -191,8 +189,8 @@ static void print_all_reports(chrony_session *s) {
 }
 
 int main(int argc, char **argv) {
+	int fd, capture_fd = -1, r = 0;
 	chrony_session *s;
-	int fd, r = 0;
 
 	fd = chrony_open_socket(argc > 1 ? argv[1] : NULL);
 	if (fd < 0) {
@@ -200,7 +198,18 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
+	/* Optionally capture the exchanges for replay */
+	if (argc > 2) {
+		capture_fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (capture_fd < 0) {
+			perror("Could not open capture");
+			chrony_close_socket(fd);
+			return 1;
+		}
+	}
+
 	if (chrony_init_session(&s, fd) == CHRONY_OK) {
+		chrony_set_session_capture(s, capture_fd);
 		print_all_reports(s);
 		chrony_deinit_session(s);
 	} else {
@@ -208,6 +217,8 @@ int main(int argc, char **argv) {
 	}
 
 	chrony_close_socket(fd);
+	if (capture_fd >= 0)
+		close(capture_fd);
 
 	return r;
 }
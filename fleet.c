@@ -0,0 +1,700 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Poller of a fleet of servers with multiple worker threads, each running
+   its own event loop with a number of sessions. Each worker has a queue of
+   pending jobs and idle workers steal half of the jobs of the worker with
+   the longest queue. The results are passed to the consumer in a bounded
+   lock-free queue with multiple producers and one consumer. */
+
+#include "message.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIN_JOB_QUEUE_SIZE 16
+#define RESULT_QUEUE_SIZE 4096
+
+typedef struct {
+	const char *address;
+	int id;
+} Job;
+
+/* Queue of pending jobs, the owner takes jobs from the head and thieves
+   from the tail */
+typedef struct {
+	pthread_mutex_t lock;
+	Job *jobs;
+	int size;
+	int head;
+	atomic_int length;
+} JobQueue;
+
+typedef struct {
+	Job job;
+	/* Opener of the socket until the opening is completed */
+	chrony_opener *opener;
+	chrony_session *session;
+	int fd;
+	int record;
+	int num_records;
+	int requests;
+	double start;
+	double deadline;
+} ActiveJob;
+
+typedef struct {
+	atomic_size_t sequence;
+	chrony_poller_result result;
+} ResultSlot;
+
+typedef struct {
+	chrony_poller *poller;
+	pthread_t thread;
+	int id;
+	JobQueue queue;
+	Job *stolen_jobs;
+	int max_stolen_jobs;
+	ActiveJob *active;
+	int num_active;
+	struct pollfd *pfds;
+	chrony_multiplexer *mux;
+	int mux_fd;
+	atomic_uint_fast64_t stolen;
+} Worker;
+
+struct chrony_poller_t {
+	const char *report;
+	int max_active;
+	double timeout;
+	bool stealing;
+	Worker *workers;
+	int num_workers;
+	int started_workers;
+	atomic_bool quit;
+	/* Pipe waking up the consumer after pushing a result */
+	int pipe_fds[2];
+	atomic_bool notified;
+	ResultSlot results[RESULT_QUEUE_SIZE];
+	atomic_size_t enqueue_pos;
+	size_t dequeue_pos;
+};
+
+static double get_monotonic_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool init_job_queue(JobQueue *q) {
+	q->jobs = calloc(MIN_JOB_QUEUE_SIZE, sizeof (*q->jobs));
+	if (!q->jobs)
+		return false;
+	q->size = MIN_JOB_QUEUE_SIZE;
+	q->head = 0;
+	atomic_init(&q->length, 0);
+	if (pthread_mutex_init(&q->lock, NULL) != 0) {
+		free(q->jobs);
+		return false;
+	}
+	return true;
+}
+
+static void deinit_job_queue(JobQueue *q) {
+	pthread_mutex_destroy(&q->lock);
+	free(q->jobs);
+}
+
+/* Resize the queue, which needs to be locked */
+static bool resize_job_queue(JobQueue *q, int min_size) {
+	int i, size, length;
+	Job *jobs;
+
+	for (size = q->size; size < min_size; size *= 2)
+		;
+
+	jobs = malloc(size * sizeof (*jobs));
+	if (!jobs)
+		return false;
+
+	length = atomic_load(&q->length);
+	for (i = 0; i < length; i++)
+		jobs[i] = q->jobs[(q->head + i) % q->size];
+
+	free(q->jobs);
+	q->jobs = jobs;
+	q->size = size;
+	q->head = 0;
+
+	return true;
+}
+
+static bool push_jobs(JobQueue *q, const Job *jobs, int n) {
+	int i, length;
+
+	pthread_mutex_lock(&q->lock);
+	length = atomic_load(&q->length);
+	if (length + n > q->size && !resize_job_queue(q, length + n)) {
+		pthread_mutex_unlock(&q->lock);
+		return false;
+	}
+	for (i = 0; i < n; i++)
+		q->jobs[(q->head + length + i) % q->size] = jobs[i];
+	atomic_store(&q->length, length + n);
+	pthread_mutex_unlock(&q->lock);
+
+	return true;
+}
+
+static bool pop_job(JobQueue *q, Job *job) {
+	bool r = false;
+
+	if (atomic_load_explicit(&q->length, memory_order_relaxed) == 0)
+		return false;
+
+	pthread_mutex_lock(&q->lock);
+	if (atomic_load(&q->length) > 0) {
+		*job = q->jobs[q->head];
+		q->head = (q->head + 1) % q->size;
+		atomic_fetch_sub(&q->length, 1);
+		r = true;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return r;
+}
+
+/* Take half of the jobs from the tail of the queue of another worker */
+static int steal_jobs_from(JobQueue *q, Worker *w) {
+	int i, n, length;
+	Job *jobs;
+
+	pthread_mutex_lock(&q->lock);
+	length = atomic_load(&q->length);
+	n = (length + 1) / 2;
+
+	if (n > w->max_stolen_jobs) {
+		jobs = realloc(w->stolen_jobs, n * sizeof (*jobs));
+		if (!jobs) {
+			pthread_mutex_unlock(&q->lock);
+			return 0;
+		}
+		w->stolen_jobs = jobs;
+		w->max_stolen_jobs = n;
+	}
+
+	for (i = 0; i < n; i++)
+		w->stolen_jobs[i] = q->jobs[(q->head + length - n + i) % q->size];
+	atomic_store(&q->length, length - n);
+	pthread_mutex_unlock(&q->lock);
+
+	return n;
+}
+
+static bool steal_jobs(Worker *w) {
+	chrony_poller *p = w->poller;
+	int i, n, length, max_length = 0;
+	Worker *victim = NULL;
+
+	/* Select the worker with the longest queue */
+	for (i = 0; i < p->num_workers; i++) {
+		length = atomic_load_explicit(&p->workers[i].queue.length, memory_order_relaxed);
+		if (&p->workers[i] != w && length > max_length) {
+			max_length = length;
+			victim = &p->workers[i];
+		}
+	}
+
+	if (!victim)
+		return false;
+
+	n = steal_jobs_from(&victim->queue, w);
+	if (n == 0)
+		return false;
+
+	/* Return the jobs if they cannot be moved */
+	if (!push_jobs(&w->queue, w->stolen_jobs, n)) {
+		while (!push_jobs(&victim->queue, w->stolen_jobs, n))
+			sched_yield();
+		return false;
+	}
+
+	atomic_fetch_add_explicit(&w->stolen, n, memory_order_relaxed);
+
+	return true;
+}
+
+static void push_result(chrony_poller *p, const chrony_poller_result *result) {
+	size_t pos, sequence;
+	ResultSlot *slot;
+
+	pos = atomic_load_explicit(&p->enqueue_pos, memory_order_relaxed);
+
+	while (1) {
+		slot = &p->results[pos % RESULT_QUEUE_SIZE];
+		sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+		if (sequence == pos) {
+			if (atomic_compare_exchange_weak_explicit(&p->enqueue_pos, &pos, pos + 1,
+								  memory_order_relaxed,
+								  memory_order_relaxed))
+				break;
+		} else if (sequence < pos) {
+			/* The queue is full, wait for the consumer, or drop the result
+			   if the poller is being destroyed */
+			if (atomic_load(&p->quit))
+				return;
+			sched_yield();
+			pos = atomic_load_explicit(&p->enqueue_pos, memory_order_relaxed);
+		} else {
+			pos = atomic_load_explicit(&p->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	slot->result = *result;
+	atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+	/* Order the store of the sequence before the load of the flag, which
+	   pairs with the fence in chrony_pop_poller_result() */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* Don't write to the pipe again if the consumer was already notified
+	   since it found the queue empty */
+	if (atomic_exchange(&p->notified, true))
+		return;
+
+	/* The pipe has room for the byte */
+	if (write(p->pipe_fds[1], "", 1) < 0)
+		return;
+}
+
+static bool pop_result(chrony_poller *p, chrony_poller_result *result) {
+	ResultSlot *slot = &p->results[p->dequeue_pos % RESULT_QUEUE_SIZE];
+
+	if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != p->dequeue_pos + 1)
+		return false;
+
+	*result = slot->result;
+	atomic_store_explicit(&slot->sequence, p->dequeue_pos + RESULT_QUEUE_SIZE,
+			      memory_order_release);
+	p->dequeue_pos++;
+
+	return true;
+}
+
+static void close_job(ActiveJob *a) {
+	if (a->opener)
+		chrony_deinit_opener(a->opener);
+	if (a->session)
+		chrony_deinit_session(a->session);
+	if (a->fd >= 0)
+		chrony_close_socket(a->fd);
+}
+
+static void finish_job(Worker *w, int index, chrony_err error, bool timeout, double now) {
+	ActiveJob *a = &w->active[index];
+	chrony_poller_result result;
+
+	result.id = a->job.id;
+	result.worker = w->id;
+	result.requests = a->requests;
+	result.timeout = timeout;
+	result.error = error;
+	result.duration = now - a->start;
+	push_result(w->poller, &result);
+
+	close_job(a);
+
+	w->active[index] = w->active[--w->num_active];
+}
+
+/* Send the next request of the job, or finish it if there is none */
+static void continue_job(Worker *w, int index, double now) {
+	ActiveJob *a = &w->active[index];
+	const char *report = w->poller->report;
+	chrony_err r;
+
+	while (1) {
+		if (a->record < 0) {
+			r = chrony_request_report_number_records(a->session, report);
+		} else if (a->record < a->num_records) {
+			r = chrony_request_record(a->session, report, a->record);
+		} else {
+			finish_job(w, index, CHRONY_OK, false, now);
+			return;
+		}
+
+		if (r != CHRONY_OK) {
+			finish_job(w, index, r, false, now);
+			return;
+		}
+
+		if (chrony_needs_response(a->session)) {
+			a->requests++;
+			a->deadline = now + w->poller->timeout;
+			return;
+		}
+
+		/* No request was needed (e.g. single-record report) */
+		if (a->record < 0)
+			a->num_records = chrony_get_report_number_records(a->session);
+		a->record++;
+	}
+}
+
+static void start_job(Worker *w, const Job *job, double now) {
+	int index = w->num_active++;
+	ActiveJob *a = &w->active[index];
+	chrony_err r;
+
+	memset(a, 0, sizeof (*a));
+	a->job = *job;
+	a->fd = -1;
+	a->record = -1;
+	a->start = now;
+
+	if (!w->mux) {
+		/* Open the socket without blocking the event loop (the Unix domain
+		   socket is opened in a separate thread) */
+		r = chrony_init_opener(&a->opener, job->address);
+		if (r != CHRONY_OK) {
+			a->opener = NULL;
+			finish_job(w, index, r, false, now);
+			return;
+		}
+		a->deadline = now + w->poller->timeout;
+		return;
+	}
+
+	r = chrony_init_multiplexed_session(&a->session, w->mux, job->address);
+	if (r != CHRONY_OK) {
+		a->session = NULL;
+		finish_job(w, index, r, false, now);
+		return;
+	}
+
+	continue_job(w, index, now);
+}
+
+/* Start the session of the job after its socket was opened */
+static void open_session(Worker *w, int index, double now) {
+	ActiveJob *a = &w->active[index];
+	chrony_err r;
+
+	a->fd = chrony_get_opened_socket(a->opener);
+	chrony_deinit_opener(a->opener);
+	a->opener = NULL;
+
+	if (a->fd < 0) {
+		finish_job(w, index, CHRONY_SEND_FAILED, false, now);
+		return;
+	}
+
+	r = chrony_init_session(&a->session, a->fd);
+	if (r != CHRONY_OK) {
+		a->session = NULL;
+		finish_job(w, index, r, false, now);
+		return;
+	}
+
+	continue_job(w, index, now);
+}
+
+static void process_job(Worker *w, int index, chrony_err r, double now) {
+	ActiveJob *a = &w->active[index];
+
+	if (r != CHRONY_OK) {
+		finish_job(w, index, r, false, now);
+		return;
+	}
+
+	if (chrony_needs_response(a->session))
+		return;
+
+	if (a->record < 0)
+		a->num_records = chrony_get_report_number_records(a->session);
+	a->record++;
+
+	continue_job(w, index, now);
+}
+
+static void process_multiplexer(Worker *w, double now) {
+	chrony_session *session;
+	chrony_err r;
+	int i;
+
+	/* Receive all responses waiting on the non-blocking socket */
+	while (1) {
+		r = chrony_process_multiplexer(w->mux, &session);
+		if (!session) {
+			if (r != CHRONY_OK)
+				break;
+			continue;
+		}
+
+		for (i = 0; i < w->num_active && w->active[i].session != session; i++)
+			;
+		if (i < w->num_active)
+			process_job(w, i, r, now);
+	}
+}
+
+static void run_event_loop(Worker *w) {
+	int i, num_fds, poll_timeout;
+	double now, deadline;
+
+	now = get_monotonic_time();
+	deadline = now + w->poller->timeout;
+
+	for (i = 0; i < w->num_active; i++) {
+		w->pfds[i].fd = w->active[i].opener ? chrony_get_opener_fd(w->active[i].opener) :
+			w->active[i].fd;
+		w->pfds[i].events = POLLIN;
+		w->pfds[i].revents = 0;
+		if (deadline > w->active[i].deadline)
+			deadline = w->active[i].deadline;
+	}
+
+	/* All sessions share one socket with multiplexing */
+	if (w->mux) {
+		w->pfds[0].fd = w->mux_fd;
+		num_fds = 1;
+	} else {
+		num_fds = w->num_active;
+	}
+
+	poll_timeout = (deadline - now) * 1000.0 + 1.0;
+	if (poll_timeout < 0)
+		poll_timeout = 0;
+
+	if (poll(w->pfds, num_fds, poll_timeout) < 0)
+		return;
+
+	now = get_monotonic_time();
+
+	if (w->mux && w->pfds[0].revents & POLLIN)
+		process_multiplexer(w, now);
+
+	/* Process the jobs in the reverse order as finished jobs are replaced
+	   by the last (already processed) job */
+	for (i = w->num_active - 1; i >= 0; i--) {
+		if (!w->mux && w->pfds[i].revents & POLLIN && w->active[i].opener)
+			open_session(w, i, now);
+		else if (!w->mux && w->pfds[i].revents & POLLIN)
+			process_job(w, i, chrony_process_response(w->active[i].session), now);
+		else if (w->active[i].deadline <= now)
+			finish_job(w, i, CHRONY_OK, true, now);
+	}
+}
+
+static void *run_worker(void *arg) {
+	Worker *w = arg;
+	chrony_poller *p = w->poller;
+	Job job;
+
+	while (!atomic_load(&p->quit)) {
+		while (w->num_active < p->max_active) {
+			if (!pop_job(&w->queue, &job) &&
+			    !(p->stealing && steal_jobs(w) && pop_job(&w->queue, &job)))
+				break;
+			start_job(w, &job, get_monotonic_time());
+		}
+
+		if (w->num_active == 0) {
+			/* Wait for new jobs */
+			usleep(1000);
+			continue;
+		}
+
+		run_event_loop(w);
+	}
+
+	/* Drop the uncompleted jobs */
+	while (w->num_active > 0)
+		close_job(&w->active[--w->num_active]);
+
+	return NULL;
+}
+
+static bool init_worker(chrony_poller *p, Worker *w, int id, bool multiplexing) {
+	w->poller = p;
+	w->id = id;
+	atomic_init(&w->stolen, 0);
+
+	if (!init_job_queue(&w->queue))
+		return false;
+
+	w->active = calloc(p->max_active, sizeof (*w->active));
+	w->pfds = calloc(p->max_active, sizeof (*w->pfds));
+	if (!w->active || !w->pfds)
+		return false;
+
+	if (multiplexing) {
+		w->mux_fd = chrony_open_multiplexer_socket();
+		if (w->mux_fd < 0 || fcntl(w->mux_fd, F_SETFL, O_NONBLOCK) < 0 ||
+		    chrony_init_multiplexer(&w->mux, w->mux_fd) != CHRONY_OK) {
+			w->mux = NULL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void deinit_worker(Worker *w) {
+	if (w->queue.jobs)
+		deinit_job_queue(&w->queue);
+	free(w->stolen_jobs);
+	free(w->active);
+	free(w->pfds);
+	if (w->mux)
+		chrony_deinit_multiplexer(w->mux);
+	if (w->mux_fd >= 0)
+		chrony_close_socket(w->mux_fd);
+}
+
+chrony_err chrony_init_poller(chrony_poller **p, const char *report_name, int num_workers,
+			      int max_active, double timeout, int flags) {
+	chrony_err r = CHRONY_NO_MEMORY;
+	int i;
+
+	if (!get_report(get_report_index(report_name)))
+		return CHRONY_UNKNOWN_REPORT;
+
+	if (num_workers < 1 || max_active < 1 || !(timeout > 0.0))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*p = calloc(1, sizeof (**p));
+	if (!*p)
+		return CHRONY_NO_MEMORY;
+
+	(*p)->report = chrony_get_report_name(get_report_index(report_name));
+	(*p)->max_active = max_active;
+	(*p)->timeout = timeout;
+	(*p)->stealing = !(flags & CHRONY_POLLER_NO_STEALING);
+	atomic_init(&(*p)->quit, false);
+	atomic_init(&(*p)->notified, false);
+	atomic_init(&(*p)->enqueue_pos, 0);
+	for (i = 0; i < RESULT_QUEUE_SIZE; i++)
+		atomic_init(&(*p)->results[i].sequence, i);
+
+	if (pipe((*p)->pipe_fds) < 0) {
+		free(*p);
+		return CHRONY_NO_PIPE;
+	}
+
+	fcntl((*p)->pipe_fds[0], F_SETFL, O_NONBLOCK);
+	fcntl((*p)->pipe_fds[1], F_SETFL, O_NONBLOCK);
+	fcntl((*p)->pipe_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl((*p)->pipe_fds[1], F_SETFD, FD_CLOEXEC);
+
+	(*p)->workers = calloc(num_workers, sizeof (*(*p)->workers));
+	if (!(*p)->workers)
+		goto error;
+	(*p)->num_workers = num_workers;
+
+	for (i = 0; i < num_workers; i++)
+		(*p)->workers[i].mux_fd = -1;
+
+	for (i = 0; i < num_workers; i++) {
+		if (!init_worker(*p, &(*p)->workers[i], i, flags & CHRONY_POLLER_MULTIPLEXING)) {
+			r = CHRONY_SEND_FAILED;
+			goto error;
+		}
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (pthread_create(&(*p)->workers[i].thread, NULL, run_worker,
+				   &(*p)->workers[i]) != 0) {
+			r = CHRONY_NO_MEMORY;
+			goto error;
+		}
+		(*p)->started_workers++;
+	}
+
+	return CHRONY_OK;
+
+error:
+	chrony_deinit_poller(*p);
+	return r;
+}
+
+void chrony_deinit_poller(chrony_poller *p) {
+	int i;
+
+	atomic_store(&p->quit, true);
+
+	for (i = 0; i < p->started_workers; i++)
+		pthread_join(p->workers[i].thread, NULL);
+
+	for (i = 0; p->workers && i < p->num_workers; i++)
+		deinit_worker(&p->workers[i]);
+
+	free(p->workers);
+	close(p->pipe_fds[0]);
+	close(p->pipe_fds[1]);
+	free(p);
+}
+
+chrony_err chrony_add_poller_job(chrony_poller *p, const char *address, int id, int worker) {
+	Job job = { .address = address, .id = id };
+
+	if (worker < 0 || worker >= p->num_workers)
+		return CHRONY_INVALID_ARGUMENT;
+
+	if (!push_jobs(&p->workers[worker].queue, &job, 1))
+		return CHRONY_NO_MEMORY;
+
+	return CHRONY_OK;
+}
+
+int chrony_get_poller_fd(chrony_poller *p) {
+	return p->pipe_fds[0];
+}
+
+bool chrony_pop_poller_result(chrony_poller *p, chrony_poller_result *result) {
+	char buf[16];
+
+	if (pop_result(p, result))
+		return true;
+
+	/* The queue is empty. Clear the notification and check the queue again
+	   to not miss a result pushed before the clearing. */
+	atomic_store(&p->notified, false);
+	while (read(p->pipe_fds[0], buf, sizeof (buf)) > 0)
+		;
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return pop_result(p, result);
+}
+
+uint64_t chrony_get_poller_stolen_jobs(chrony_poller *p, int worker) {
+	if (worker < 0 || worker >= p->num_workers)
+		return 0;
+
+	return atomic_load_explicit(&p->workers[worker].stolen, memory_order_relaxed);
+}
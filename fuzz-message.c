@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* In-process fuzz target of the message code compatible with libFuzzer
+   (compiled with -DLIBFUZZER), or reading inputs from files (or stdin).
+
+   Input of the response side: mode byte with even value, report index,
+   flags (bit 0 for the number of records, bit 1 to match the sequence
+   number of the request), and the response.
+
+   Input of the request side: mode byte with odd value, report index,
+   flags, sequence number (4 bytes), index or address of the record
+   (20 bytes), response variant and number of sources of the synthetic
+   server, which has to accept the request. */
+
+#include "synth.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RESPONSE_DATA 3
+#define REQUEST_DATA 29
+
+typedef union {
+	chrony_tracking_record tracking;
+	chrony_sources_record sources;
+	chrony_sourcestats_record sourcestats;
+	chrony_selectdata_record selectdata;
+	chrony_activity_record activity;
+	chrony_authdata_record authdata;
+	chrony_ntpdata_record ntpdata;
+	chrony_serverstats_record serverstats;
+	chrony_rtcdata_record rtcdata;
+	chrony_smoothing_record smoothing;
+} Record;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint64_t add_hash(uint64_t hash, const void *data, size_t len) {
+	const unsigned char *d = data;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; i < len; i++)
+		hash = (hash ^ d[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static uint64_t add_hash_string(uint64_t hash, const char *s) {
+	return s ? add_hash(hash, s, strlen(s) + 1) : add_hash(hash, "", 1);
+}
+
+#define HASH_VALUE(hash, value) \
+	do { \
+		__typeof__(value) v_ = (value); \
+		hash = add_hash(hash, &v_, sizeof (v_)); \
+	} while (0)
+
+#define HASH_DECODER(hash, msg, report) \
+	do { \
+		Record r_; \
+		memset(&r_, 0, sizeof (r_)); \
+		HASH_VALUE(hash, decode_##report##_record(msg, &r_.report)); \
+		hash = add_hash(hash, &r_.report, sizeof (r_.report)); \
+	} while (0)
+
+static uint64_t hash_decoders(uint64_t hash, const Message *msg) {
+	/* Only one decoder accepts the fields of the response */
+	HASH_DECODER(hash, msg, tracking);
+	HASH_DECODER(hash, msg, sources);
+	HASH_DECODER(hash, msg, sourcestats);
+	HASH_DECODER(hash, msg, selectdata);
+	HASH_DECODER(hash, msg, activity);
+	HASH_DECODER(hash, msg, authdata);
+	HASH_DECODER(hash, msg, ntpdata);
+	HASH_DECODER(hash, msg, serverstats);
+	HASH_DECODER(hash, msg, rtcdata);
+	HASH_DECODER(hash, msg, smoothing);
+
+	return hash;
+}
+
+static uint64_t hash_projection(uint64_t hash, const Message *msg) {
+	ProjectedField fields[64];
+	chrony_field_value values[64];
+	int i, n;
+
+	/* Project all fields, including the address and reference ID */
+	for (i = n = 0; msg->fields[i].type != TYPE_NONE && n + 1 < 64; i++) {
+		if (!resolve_projected_field(msg->fields, msg->fields[i].name, &fields[n]))
+			abort();
+		n++;
+		if (msg->fields[i].type == TYPE_ADDRESS_OR_UINT32_IN_ADDRESS &&
+		    resolve_projected_field(msg->fields, msg->fields[i].name +
+					    strlen(msg->fields[i].name) + 1, &fields[n]))
+			n++;
+	}
+
+	if (n == 0)
+		return hash;
+
+	memset(values, 0, sizeof (values));
+	project_fields(msg, fields, n, values);
+
+	return add_hash(hash, values, n * sizeof (values[0]));
+}
+
+/* Change each field of the response separately and check that the change
+   is detected in all fields except reserved */
+static void check_diff(const Message *msg) {
+	int i, n, data_len, changed_fields[1];
+	Message changed;
+
+	if (msg->num_fields < 1)
+		return;
+
+	data_len = get_field_position(msg, msg->num_fields - 1) +
+		get_field_len(msg->fields, msg->num_fields - 1) - RESPONSE_HEADER_LEN;
+
+	if (diff_message_fields(msg, msg, data_len, changed_fields, 1) != 0)
+		abort();
+
+	for (i = 0; i < msg->num_fields; i++) {
+		changed = *msg;
+		changed.msg[get_field_position(msg, i)] ^= 0x1;
+		n = diff_message_fields(msg, &changed, data_len, changed_fields, 1);
+		if (msg->fields[i].reserved ? n != 0 : n != 1 || changed_fields[0] != i)
+			abort();
+	}
+}
+
+/* Run all accessors and return a hash of the results */
+static uint64_t check_response(const Message *request, Message *response,
+			       const Response *expected_responses) {
+	uint64_t flag, hash = 0xcbf29ce484222325ULL;
+	Schema schema = { 0 };
+	const char *names[4];
+	chrony_err r;
+	int i, j, n;
+
+	/* Invalid responses are ignored by the library */
+	if (!is_response_valid(request, response))
+		return hash;
+
+	r = process_response(response, expected_responses, &schema);
+	HASH_VALUE(hash, r);
+	if (r != CHRONY_OK)
+		return hash;
+
+	/* The schema learned from the response needs to give the same result */
+	n = response->num_fields;
+	if (process_response(response, expected_responses, &schema) != CHRONY_OK ||
+	    response->num_fields != n)
+		abort();
+
+	if (response->num_fields < 0 || response->len > MAX_MESSAGE_LEN ||
+	    get_field_position(response, response->num_fields - 1) >= response->len)
+		abort();
+
+	for (i = -1; i <= response->num_fields; i++) {
+		HASH_VALUE(hash, get_field_position(response, i));
+		HASH_VALUE(hash, resolve_field_type(response, i));
+		hash = add_hash_string(hash, resolve_field_name(response, i));
+		HASH_VALUE(hash, resolve_field_content(response, i));
+		HASH_VALUE(hash, get_field_uinteger(response, i));
+		HASH_VALUE(hash, get_field_integer(response, i));
+		HASH_VALUE(hash, get_field_float(response, i));
+		HASH_VALUE(hash, get_field_timespec(response, i));
+		hash = add_hash_string(hash, get_field_string(response, i));
+		for (flag = 1; flag != 0; flag <<= 1)
+			hash = add_hash_string(hash, get_field_constant_name(response, i, flag));
+		hash = add_hash_string(hash, get_field_constant_name(response, i,
+								      get_field_uinteger(response, i)));
+		n = get_field_flag_names(response, i, get_field_uinteger(response, i), names, 4);
+		HASH_VALUE(hash, n);
+		for (j = 0; j < n && j < 4; j++)
+			hash = add_hash_string(hash, names[j]);
+	}
+
+	hash = hash_decoders(hash, response);
+	hash = hash_projection(hash, response);
+	check_diff(response);
+
+	return hash;
+}
+
+/* Request reused across the inputs */
+static Message request;
+
+static const RequestTemplate *get_template(const uint8_t *data, const Report **report,
+					   bool *count) {
+	int report_index = data[1] % chrony_get_number_supported_reports();
+
+	*report = get_report(report_index);
+	*count = data[2] & 1;
+
+	/* Not all reports have the number of records */
+	if (*count && (*report)->count_requests[0].code == 0)
+		return NULL;
+
+	return get_request_template(report_index, *count);
+}
+
+static void format_template(Message *request, const RequestTemplate *template,
+			    uint32_t sequence, const uint8_t *value) {
+	void *args[1];
+	uint32_t index;
+	char address[20];
+
+	memcpy(&index, value, sizeof (index));
+	memcpy(address, value, sizeof (address));
+
+	args[0] = template->num_fields > 0 && template->fields[0].type == TYPE_ADDRESS ?
+		(void *)address : (void *)&index;
+
+	format_request(request, sequence, template, args);
+}
+
+/* Get the template of the longest record request with an address */
+static const RequestTemplate *get_address_template(void) {
+	static const RequestTemplate *address_template;
+	const RequestTemplate *template;
+	int i;
+
+	if (address_template)
+		return address_template;
+
+	for (i = 0; i < chrony_get_number_supported_reports(); i++) {
+		template = get_request_template(i, false);
+		if (template->num_fields > 0 && template->fields[0].type == TYPE_ADDRESS &&
+		    (!address_template || address_template->data_len < template->data_len))
+			address_template = template;
+	}
+
+	return address_template;
+}
+
+static void fuzz_response(const uint8_t *data, size_t size) {
+	static const uint8_t value[20];
+	const RequestTemplate *template;
+	Message response;
+	const Report *report;
+	uint64_t hashes[2];
+	size_t len;
+	bool count;
+	int i;
+
+	template = get_template(data, &report, &count);
+	if (!template)
+		return;
+
+	format_template(&request, template, 1, value);
+
+	len = size - RESPONSE_DATA;
+	if (len > sizeof (response.msg))
+		len = sizeof (response.msg);
+
+	/* Fill the buffer past the response with different data to detect
+	   reading of data past the received length */
+	for (i = 0; i < 2; i++) {
+		memset(&response, i ? 0xff : 0, sizeof (response));
+		memcpy(response.msg, data + RESPONSE_DATA, len);
+		response.len = len;
+		if (data[2] & 2 && len >= 20)
+			memcpy(&response.msg[16], &request.msg[8], 4);
+
+		hashes[i] = check_response(&request, &response, count ? report->count_responses :
+					   report->record_responses);
+	}
+
+	if (hashes[0] != hashes[1]) {
+		fprintf(stderr, "Result depends on data past response\n");
+		abort();
+	}
+}
+
+static void fuzz_request(const uint8_t *data, size_t size) {
+	const RequestTemplate *template;
+	uint8_t address[20];
+	Message response;
+	SynthConfig config;
+	const Report *report;
+	uint32_t sequence;
+	bool count;
+	chrony_err r;
+	int i;
+
+	if (size < REQUEST_DATA)
+		return;
+
+	template = get_template(data, &report, &count);
+	if (!template)
+		return;
+
+	memcpy(&sequence, data + 3, sizeof (sequence));
+
+	/* Like the client, reuse the message without clearing it. Format a
+	   request with an address first to detect data left past the data of
+	   the checked request. */
+	if (get_address_template()) {
+		memset(address, 0xff, sizeof (address));
+		format_template(&request, get_address_template(), ~sequence, address);
+	}
+
+	format_template(&request, template, sequence, data + 7);
+
+	if (request.len < REQUEST_HEADER_LEN || request.len > MAX_MESSAGE_LEN ||
+	    request.msg[0] != 6 || request.msg[1] != 1 ||
+	    *(uint32_t *)&request.msg[8] != htonl(sequence))
+		abort();
+
+	/* The padding needs to be zero */
+	for (i = template->data_len; i < request.len; i++) {
+		if (request.msg[i] != 0)
+			abort();
+	}
+
+	config.response_variant = data[27] % MAX_RESPONSES;
+	config.num_sources = data[28];
+
+	if (!synth_respond(&response, &request, &config))
+		abort();
+
+	if (!is_response_valid(&request, &response))
+		abort();
+
+	check_response(&request, &response, count ? report->count_responses :
+		       report->record_responses);
+
+	/* The server may only reject an invalid index or address */
+	r = process_response(&response, count ? report->count_responses :
+			     report->record_responses, NULL);
+	if (r != CHRONY_OK && r != CHRONY_UNEXPECTED_STATUS)
+		abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (size < RESPONSE_DATA)
+		return 0;
+
+	if (data[0] % 2 == 0)
+		fuzz_response(data, size);
+	else
+		fuzz_request(data, size);
+
+	return 0;
+}
+
+#ifndef LIBFUZZER
+static int run_file(FILE *f) {
+	uint8_t data[2 * MAX_MESSAGE_LEN];
+	size_t size;
+
+	size = fread(data, 1, sizeof (data), f);
+	if (ferror(f))
+		return 1;
+
+	LLVMFuzzerTestOneInput(data, size);
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	FILE *f;
+	int i;
+
+	if (argc < 2)
+		return run_file(stdin);
+
+	for (i = 1; i < argc; i++) {
+		f = fopen(argv[i], "rb");
+		if (!f) {
+			perror(argv[i]);
+			return 1;
+		}
+		if (run_file(f))
+			return 1;
+		fclose(f);
+	}
+
+	return 0;
+}
+#endif
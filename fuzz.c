@@ -22,6 +22,8 @@
 #include <inttypes.h>
 #include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -29,6 +31,7 @@ static FILE *in;
 static FILE *out;
 static int server_fd;
 static uint32_t sequence;
+static int poison;
 
 static int receive_request(void) {
 	struct pollfd pfd = { .fd = server_fd, .events = POLLIN };
@@ -47,7 +50,7 @@ static int receive_request(void) {
 }
 
 static int send_responses(void) {
-	char buf[65536];
+	char buf[65536], junk[1024];
 	uint16_t len;
 	int i;
 
@@ -58,6 +61,15 @@ static int send_responses(void) {
 		return 0;
 	if (len >= 20 && buf[19] != 0)
 		*(uint32_t *)&buf[16] = sequence;
+
+	if (poison) {
+		/* Fill the receive buffer with an invalid response to detect
+		   reading of data past the length of the following response */
+		memset(junk, 0xff, sizeof (junk));
+		if (send(server_fd, junk, sizeof (junk), 0) < 0)
+			return 0;
+	}
+
 	for (i = 0; i < 2; i++) {
 		fprintf(stderr, "send\n");
 		if (send(server_fd, buf, len, 0) < 0)
@@ -74,6 +86,12 @@ static chrony_err process_responses(chrony_session *s) {
 		if (!receive_request() || !send_responses())
 			return CHRONY_RECV_FAILED;
 
+		if (poison) {
+			r = chrony_process_response(s);
+			if (r != CHRONY_OK || !chrony_needs_response(s))
+				abort();
+		}
+
 		r = chrony_process_response(s);
 		if (r != CHRONY_OK)
 			return r;
@@ -151,21 +169,10 @@ static int dump_report(chrony_session *s, int report_index) {
 	return CHRONY_OK;
 }
 
-int main(int argc, char **argv) {
+static int run(void) {
 	int fd[2], report_index;
 	chrony_session *s;
 
-	in = stdin;
-	if (0) {
-		out = fopen("/dev/null", "w");
-		if (!out) {
-			perror("fopen");
-			return 1;
-		}
-	} else {
-		out = stdout;
-	}
-
 	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) < 0) {
 		perror("socketpair");
 		return 1;
@@ -175,19 +182,66 @@ int main(int argc, char **argv) {
 	if (chrony_init_session(&s, fd[0]) != CHRONY_OK)
 		return 1;
 
-	if (fread(&report_index, sizeof (report_index), 1, in) != 1)
-		return 0;
-	report_index = ntohl(report_index);
-	fprintf(out, "%d\n", report_index);
+	if (fread(&report_index, sizeof (report_index), 1, in) == 1) {
+		report_index = ntohl(report_index);
+		fprintf(out, "%d\n", report_index);
 
-	dump_report(s, report_index);
+		dump_report(s, report_index);
+	}
 
 	chrony_deinit_session(s);
 
 	close(fd[0]);
 	close(fd[1]);
-	fclose(in);
-	fclose(out);
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	char *input = NULL, *output[2] = { NULL, NULL };
+	size_t input_len = 0, output_len[2];
+	FILE *f;
+	int c;
+
+	/* Read the whole input to run the library twice, second time with
+	   the receive buffer poisoned before each response. The output must
+	   be identical. */
+	f = open_memstream(&input, &input_len);
+	if (!f)
+		return 1;
+	while ((c = getchar()) != EOF)
+		fputc(c, f);
+	fclose(f);
+
+	if (input_len == 0)
+		return 0;
+
+	for (poison = 0; poison < 2; poison++) {
+		in = fmemopen(input, input_len, "r");
+		out = open_memstream(&output[poison], &output_len[poison]);
+		if (!in || !out) {
+			perror("fmemopen");
+			return 1;
+		}
+
+		if (run())
+			return 1;
+
+		fclose(in);
+		fclose(out);
+	}
+
+	if (output_len[0] != output_len[1] ||
+	    memcmp(output[0], output[1], output_len[0]) != 0) {
+		fprintf(stderr, "Output depends on data past response\n");
+		abort();
+	}
+
+	fwrite(output[0], 1, output_len[0], stdout);
+
+	free(input);
+	free(output[0]);
+	free(output[1]);
 
 	return 0;
 }
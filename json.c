@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Encoding of records in JSON without memory allocation. The fields are
+   read in one pass over the Field table of the record. The output is
+   written to a buffer, or to a list of chunks where the names of fields
+   and constants point to the tables of reports. */
+
+#include "message.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <sys/uio.h>
+
+typedef struct {
+	/* Buffer of the output, or the scratch buffer of the chunks */
+	char *buf;
+	size_t size;
+	/* Length of the complete output in the buffer, or the used part of
+	   the scratch buffer */
+	size_t len;
+	struct iovec *iov;
+	int max_iov;
+	int num_iov;
+	bool overflow;
+} Output;
+
+static void add_chunk(Output *out, const char *data, size_t len) {
+	struct iovec *last;
+
+	/* Extend the last chunk if the data follows it */
+	if (out->num_iov > 0) {
+		last = &out->iov[out->num_iov - 1];
+		if ((char *)last->iov_base + last->iov_len == data) {
+			last->iov_len += len;
+			return;
+		}
+	}
+
+	if (out->num_iov >= out->max_iov) {
+		out->overflow = true;
+		return;
+	}
+
+	out->iov[out->num_iov].iov_base = (void *)data;
+	out->iov[out->num_iov].iov_len = len;
+	out->num_iov++;
+}
+
+/* Write data which needs to be copied */
+static void put_data(Output *out, const char *data, size_t len) {
+	if (out->iov) {
+		if (out->len + len > out->size) {
+			out->overflow = true;
+			return;
+		}
+		memcpy(out->buf + out->len, data, len);
+		add_chunk(out, out->buf + out->len, len);
+	} else if (out->len < out->size) {
+		memcpy(out->buf + out->len, data, out->len + len <= out->size ?
+		       len : out->size - out->len);
+	}
+
+	out->len += len;
+}
+
+/* Write a constant string of the library, which can be referenced */
+static void put_constant(Output *out, const char *s) {
+	if (out->iov)
+		add_chunk(out, s, strlen(s));
+	else
+		put_data(out, s, strlen(s));
+}
+
+static void put_char(Output *out, char c) {
+	put_data(out, &c, 1);
+}
+
+static void put_uinteger(Output *out, uint64_t x) {
+	char buf[20];
+	int i = sizeof (buf);
+
+	do {
+		buf[--i] = '0' + x % 10;
+		x /= 10;
+	} while (x > 0);
+
+	put_data(out, buf + i, sizeof (buf) - i);
+}
+
+static void put_integer(Output *out, int64_t x) {
+	if (x < 0) {
+		put_char(out, '-');
+		put_uinteger(out, -(uint64_t)x);
+	} else {
+		put_uinteger(out, x);
+	}
+}
+
+/* Format a float with 8 significant digits in the same form as the %.8g
+   format of printf() (the values have at most 25 bits of precision) */
+static void put_float(Output *out, double x) {
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+		1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	char digits[8], buf[32];
+	int i, j, exp, num_digits, len;
+	uint64_t mantissa;
+	double m;
+
+	if (!isfinite(x)) {
+		put_data(out, "null", 4);
+		return;
+	}
+
+	len = 0;
+
+	if (x < 0.0) {
+		buf[len++] = '-';
+		x = -x;
+	}
+
+	if (x == 0.0) {
+		buf[len++] = '0';
+		put_data(out, buf, len);
+		return;
+	}
+
+	exp = floor(log10(x));
+
+	/* Scale the value to 8 digits before the decimal point with one
+	   rounding and correct the exponent for errors in log10() */
+	for (j = 0; j < 2; j++) {
+		i = 7 - exp;
+		if (i >= 0 && i < (int)(sizeof (powers) / sizeof (powers[0])))
+			m = x * powers[i];
+		else if (i < 0 && -i < (int)(sizeof (powers) / sizeof (powers[0])))
+			m = x / powers[-i];
+		else
+			m = x * pow(10.0, i);
+
+		if (j > 0 || (m >= 1e7 && m < 1e8))
+			break;
+		exp += m >= 1e8 ? 1 : -1;
+	}
+
+	mantissa = rint(m);
+	if (mantissa >= 100000000) {
+		mantissa /= 10;
+		exp++;
+	} else if (mantissa < 10000000) {
+		mantissa *= 10;
+		exp--;
+	}
+
+	for (i = 7; i >= 0; i--) {
+		digits[i] = '0' + mantissa % 10;
+		mantissa /= 10;
+	}
+
+	for (num_digits = 8; num_digits > 1 && digits[num_digits - 1] == '0'; num_digits--)
+		;
+
+	if (exp >= -4 && exp < 8) {
+		if (exp >= 0) {
+			for (i = 0; i <= exp; i++)
+				buf[len++] = i < num_digits ? digits[i] : '0';
+			if (num_digits > exp + 1)
+				buf[len++] = '.';
+			for (; i < num_digits; i++)
+				buf[len++] = digits[i];
+		} else {
+			buf[len++] = '0';
+			buf[len++] = '.';
+			for (i = -1; i > exp; i--)
+				buf[len++] = '0';
+			for (i = 0; i < num_digits; i++)
+				buf[len++] = digits[i];
+		}
+	} else {
+		buf[len++] = digits[0];
+		if (num_digits > 1)
+			buf[len++] = '.';
+		for (i = 1; i < num_digits; i++)
+			buf[len++] = digits[i];
+		buf[len++] = 'e';
+		buf[len++] = exp < 0 ? '-' : '+';
+		if (exp < 0)
+			exp = -exp;
+		if (exp >= 100)
+			buf[len++] = '0' + exp / 100;
+		buf[len++] = '0' + exp / 10 % 10;
+		buf[len++] = '0' + exp % 10;
+	}
+
+	put_data(out, buf, len);
+}
+
+static void put_timespec(Output *out, struct timespec ts) {
+	char buf[10];
+	long nsec = ts.tv_nsec;
+	int i;
+
+	put_integer(out, ts.tv_sec);
+
+	for (i = 9; i >= 1; i--) {
+		buf[i] = '0' + nsec % 10;
+		nsec /= 10;
+	}
+	buf[0] = '.';
+
+	put_data(out, buf, sizeof (buf));
+}
+
+static void put_string(Output *out, const char *s, bool constant) {
+	put_char(out, '"');
+	if (constant)
+		put_constant(out, s);
+	else
+		put_data(out, s, strlen(s));
+	put_char(out, '"');
+}
+
+static const char *get_unit(chrony_field_content content) {
+	switch (content) {
+	case CHRONY_CONTENT_TIME:
+	case CHRONY_CONTENT_INTERVAL_SECONDS:
+	case CHRONY_CONTENT_OFFSET_SECONDS:
+	case CHRONY_CONTENT_MEASURE_SECONDS:
+		return "s";
+	case CHRONY_CONTENT_INTERVAL_LOG2_SECONDS:
+		return "log2(s)";
+	case CHRONY_CONTENT_OFFSET_PPM:
+	case CHRONY_CONTENT_MEASURE_PPM:
+		return "ppm";
+	case CHRONY_CONTENT_OFFSET_PPM_PER_SECOND:
+		return "ppm/s";
+	case CHRONY_CONTENT_LENGTH_BITS:
+		return "bits";
+	case CHRONY_CONTENT_LENGTH_BYTES:
+		return "bytes";
+	default:
+		return NULL;
+	}
+}
+
+static void put_uinteger_field(Output *out, const Field *field, chrony_field_content content,
+			       uint64_t value) {
+	static const char hex[] = "0123456789ABCDEF";
+	const char *name, *names[64];
+	char buf[8];
+	int i, n;
+
+	switch (content) {
+	case CHRONY_CONTENT_REFERENCE_ID:
+		for (i = 0; i < 8; i++)
+			buf[i] = hex[(value >> (28 - 4 * i)) & 0xf];
+		put_char(out, '"');
+		put_data(out, buf, sizeof (buf));
+		put_char(out, '"');
+		break;
+	case CHRONY_CONTENT_ENUM:
+		name = get_constant_name(field->constants, value);
+		if (name)
+			put_string(out, name, true);
+		else
+			put_uinteger(out, value);
+		break;
+	case CHRONY_CONTENT_FLAGS:
+		n = get_constant_flag_names(field->constants, value, names, 64);
+		put_char(out, '[');
+		for (i = 0; i < n; i++) {
+			if (i > 0)
+				put_char(out, ',');
+			put_string(out, names[i], true);
+		}
+		put_char(out, ']');
+		break;
+	case CHRONY_CONTENT_BOOLEAN:
+		if (value)
+			put_data(out, "true", 4);
+		else
+			put_data(out, "false", 5);
+		break;
+	default:
+		put_uinteger(out, value);
+		break;
+	}
+}
+
+static void encode_record(const Message *msg, int flags, Output *out) {
+	chrony_field_content content;
+	chrony_field_value value;
+	const Field *field;
+	const char *name, *unit;
+	int i, position;
+	FieldType type;
+	bool first;
+
+	put_char(out, '{');
+
+	for (i = 0, position = RESPONSE_HEADER_LEN, first = true; i < msg->num_fields;
+	     position += get_field_len(msg->fields, i), i++) {
+		field = &msg->fields[i];
+		if (field->reserved)
+			continue;
+
+		name = field->name;
+		type = field->type;
+		content = field->content;
+
+		/* The address or reference ID depends on the record */
+		if (type == TYPE_ADDRESS_OR_UINT32_IN_ADDRESS) {
+			name = resolve_field_name(msg, i);
+			type = resolve_field_type(msg, i);
+			content = type == TYPE_ADDRESS ? CHRONY_CONTENT_ADDRESS :
+				CHRONY_CONTENT_REFERENCE_ID;
+		}
+
+		read_field_value(msg, position, type, get_value_type(type), &value);
+
+		/* Missing address */
+		if (type == TYPE_ADDRESS && value.string[0] == '\0')
+			continue;
+
+		if (first)
+			put_char(out, '"');
+		else
+			put_data(out, ",\"", 2);
+		first = false;
+
+		put_constant(out, name);
+		put_data(out, "\":", 2);
+
+		unit = flags & CHRONY_JSON_UNITS ? get_unit(content) : NULL;
+		if (unit)
+			put_data(out, "{\"value\":", 9);
+
+		switch (get_value_type(type)) {
+		case CHRONY_TYPE_UINTEGER:
+			put_uinteger_field(out, field, content, value.uinteger);
+			break;
+		case CHRONY_TYPE_INTEGER:
+			put_integer(out, value.integer);
+			break;
+		case CHRONY_TYPE_FLOAT:
+			put_float(out, value.floating);
+			break;
+		case CHRONY_TYPE_TIMESPEC:
+			put_timespec(out, value.timespec);
+			break;
+		case CHRONY_TYPE_STRING:
+			put_string(out, value.string, false);
+			break;
+		default:
+			put_data(out, "null", 4);
+			break;
+		}
+
+		if (unit) {
+			put_data(out, ",\"unit\":", 8);
+			put_string(out, unit, true);
+			put_char(out, '}');
+		}
+	}
+
+	put_char(out, '}');
+}
+
+int chrony_format_record_json(chrony_session *s, int flags, char *buf, size_t size) {
+	const Message *msg;
+	Output out;
+
+	msg = get_session_record(s);
+	if (!msg)
+		return -1;
+
+	memset(&out, 0, sizeof (out));
+	out.buf = buf;
+	out.size = size;
+
+	encode_record(msg, flags, &out);
+
+	if (size > 0)
+		buf[out.len < size ? out.len : size - 1] = '\0';
+
+	return out.len;
+}
+
+int chrony_format_record_json_iov(chrony_session *s, int flags, struct iovec *iov, int max_iov,
+				  char *scratch, size_t scratch_size) {
+	const Message *msg;
+	Output out;
+
+	msg = get_session_record(s);
+	if (!msg)
+		return -1;
+
+	memset(&out, 0, sizeof (out));
+	out.buf = scratch;
+	out.size = scratch_size;
+	out.iov = iov;
+	out.max_iov = max_iov;
+
+	encode_record(msg, flags, &out);
+
+	if (out.overflow)
+		return -1;
+
+	return out.num_iov;
+}
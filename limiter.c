@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Token-bucket limiter of the rate of requests shared by sessions, which
+   reserves the send times of requests in the order they are made and
+   decreases the rate when responses are missing, in order to not exceed
+   the rate limit of the server and cause dropped requests */
+
+#include "message.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Factor applied to the rate on a missing response and the fraction of the
+   maximum rate added on a received response */
+#define RATE_DECREASE 0.5
+#define RATE_INCREASE 0.005
+
+/* Minimum rate relative to the maximum rate */
+#define MIN_RATE_RATIO (1.0 / 64)
+
+struct chrony_limiter_t {
+	pthread_mutex_t lock;
+	double max_rate;
+	double rate;
+	double burst;
+	/* Time when the bucket will be full again with all reserved tokens */
+	double full_time;
+	/* Time of the last decrease of the rate */
+	double decrease_time;
+};
+
+chrony_err chrony_init_limiter(chrony_limiter **l, double rate, double burst) {
+	if (!(rate > 0.0) || !(burst >= 1.0))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*l = calloc(1, sizeof (**l));
+	if (!*l)
+		return CHRONY_NO_MEMORY;
+
+	if (pthread_mutex_init(&(*l)->lock, NULL) != 0) {
+		free(*l);
+		return CHRONY_NO_MEMORY;
+	}
+
+	(*l)->max_rate = rate;
+	(*l)->rate = rate;
+	(*l)->burst = burst;
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_limiter(chrony_limiter *l) {
+	pthread_mutex_destroy(&l->lock);
+	free(l);
+}
+
+double chrony_get_limiter_rate(chrony_limiter *l) {
+	double rate;
+
+	pthread_mutex_lock(&l->lock);
+	rate = l->rate;
+	pthread_mutex_unlock(&l->lock);
+
+	return rate;
+}
+
+double reserve_limiter_token(chrony_limiter *l, double now) {
+	double interval, send_time;
+
+	pthread_mutex_lock(&l->lock);
+
+	interval = 1.0 / l->rate;
+
+	if (l->full_time < now)
+		l->full_time = now;
+
+	/* The token is available when the bucket is not overfilled with the
+	   reserved tokens */
+	send_time = l->full_time - (l->burst - 1.0) * interval;
+	if (send_time < now)
+		send_time = now;
+
+	l->full_time += interval;
+
+	pthread_mutex_unlock(&l->lock);
+
+	return send_time;
+}
+
+void increase_limiter_rate(chrony_limiter *l) {
+	pthread_mutex_lock(&l->lock);
+
+	l->rate += RATE_INCREASE * l->max_rate;
+	if (l->rate > l->max_rate)
+		l->rate = l->max_rate;
+
+	pthread_mutex_unlock(&l->lock);
+}
+
+void decrease_limiter_rate(chrony_limiter *l, double send_time, double now) {
+	pthread_mutex_lock(&l->lock);
+
+	/* Requests sent before the last decrease were sent at the higher rate
+	   and their missing responses don't need another decrease */
+	if (send_time >= l->decrease_time) {
+		l->rate *= RATE_DECREASE;
+		if (l->rate < MIN_RATE_RATIO * l->max_rate)
+			l->rate = MIN_RATE_RATIO * l->max_rate;
+		l->decrease_time = now;
+	}
+
+	pthread_mutex_unlock(&l->lock);
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Load generator issuing requests from many sessions to the chronyd
+   command port at a target rate and reporting the achieved throughput,
+   latency and number of requests which timed out, optionally with a rate
+   limiter shared by the sessions */
+
+#include "chrony.h"
+
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_MIX 32
+
+typedef struct {
+	chrony_session *session;
+	int fd;
+	const char *report;
+	int record;
+	int num_records;
+	double sent;
+	bool busy;
+} Client;
+
+typedef struct {
+	const char *report;
+	int weight;
+} MixEntry;
+
+typedef struct {
+	uint64_t reports;
+	uint64_t requests;
+	uint64_t timeouts;
+	uint64_t errors;
+	uint64_t skipped;
+	double *latencies;
+	size_t num_latencies;
+	size_t max_latencies;
+} Results;
+
+static MixEntry mix[MAX_MIX];
+static int num_mix;
+static int total_weight;
+static double timeout = 1.0;
+static chrony_limiter *limiter;
+static Results results;
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool parse_mix(char *arg) {
+	char *s, *w;
+
+	for (s = strtok(arg, ","); s; s = strtok(NULL, ",")) {
+		if (num_mix >= MAX_MIX)
+			return false;
+		w = strchr(s, ':');
+		if (w)
+			*w++ = '\0';
+		mix[num_mix].report = s;
+		mix[num_mix].weight = w ? atoi(w) : 1;
+		if (mix[num_mix].weight <= 0)
+			return false;
+		total_weight += mix[num_mix].weight;
+		num_mix++;
+	}
+
+	return num_mix > 0;
+}
+
+static const char *select_report(void) {
+	int i, x = random() % total_weight;
+
+	for (i = 0; i < num_mix; i++) {
+		x -= mix[i].weight;
+		if (x < 0)
+			break;
+	}
+
+	return mix[i].report;
+}
+
+static void add_latency(double latency) {
+	double *l;
+
+	if (results.num_latencies >= results.max_latencies) {
+		results.max_latencies = results.max_latencies ? 2 * results.max_latencies : 1024;
+		l = realloc(results.latencies, results.max_latencies * sizeof (*l));
+		if (!l) {
+			fprintf(stderr, "Could not allocate memory\n");
+			exit(1);
+		}
+		results.latencies = l;
+	}
+
+	results.latencies[results.num_latencies++] = latency;
+}
+
+static void finish_job(Client *c, chrony_err r) {
+	c->busy = false;
+
+	if (r == CHRONY_OK) {
+		results.reports++;
+	} else {
+		results.errors++;
+		fprintf(stderr, "%s: %s\n", c->report, chrony_get_error_string(r));
+	}
+}
+
+/* Send the next request of the job, or finish it if there is none */
+static void continue_job(Client *c, double now) {
+	double delay;
+	chrony_err r;
+
+	while (1) {
+		if (c->record < 0) {
+			r = chrony_request_report_number_records(c->session, c->report);
+		} else if (c->record < c->num_records) {
+			r = chrony_request_record(c->session, c->report, c->record);
+		} else {
+			finish_job(c, CHRONY_OK);
+			return;
+		}
+
+		if (r != CHRONY_OK) {
+			finish_job(c, r);
+			return;
+		}
+
+		if (chrony_needs_response(c->session)) {
+			/* Requests queued by the limiter are sent later */
+			delay = chrony_get_send_delay(c->session);
+			c->sent = delay > 0.0 ? now + delay : now;
+			return;
+		}
+
+		/* No request was needed (e.g. single-record report) */
+		if (c->record < 0)
+			c->num_records = chrony_get_report_number_records(c->session);
+		c->record++;
+	}
+}
+
+static void start_job(Client *c, double now) {
+	c->busy = true;
+	c->report = select_report();
+	c->record = -1;
+	c->num_records = 0;
+	continue_job(c, now);
+}
+
+static void process_client(Client *c, double now) {
+	chrony_err r;
+
+	r = chrony_process_response(c->session);
+	if (r != CHRONY_OK) {
+		finish_job(c, r);
+		return;
+	}
+
+	if (chrony_needs_response(c->session))
+		return;
+
+	results.requests++;
+	add_latency(now - c->sent);
+
+	if (c->record < 0)
+		c->num_records = chrony_get_report_number_records(c->session);
+	c->record++;
+
+	continue_job(c, now);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double get_percentile(double p) {
+	size_t i;
+
+	if (results.num_latencies == 0)
+		return 0.0;
+
+	i = p / 100.0 * (results.num_latencies - 1) + 0.5;
+	return results.latencies[i];
+}
+
+static void print_results(double duration, int num_clients) {
+	qsort(results.latencies, results.num_latencies, sizeof (double), compare_doubles);
+
+	printf("Sessions:         %d\n", num_clients);
+	printf("Duration:         %.3f s\n", duration);
+	printf("Reports:          %"PRIu64" (%.1f/s)\n", results.reports,
+	       results.reports / duration);
+	printf("Requests:         %"PRIu64" (%.1f/s)\n", results.requests,
+	       results.requests / duration);
+	printf("Timeouts:         %"PRIu64" (%.3f%%)\n", results.timeouts,
+	       100.0 * results.timeouts / (results.requests + results.timeouts + 1e-9));
+	printf("Errors:           %"PRIu64"\n", results.errors);
+	printf("Skipped (busy):   %"PRIu64"\n", results.skipped);
+	printf("Latency p50:      %.1f us\n", get_percentile(50.0) * 1e6);
+	printf("Latency p90:      %.1f us\n", get_percentile(90.0) * 1e6);
+	printf("Latency p99:      %.1f us\n", get_percentile(99.0) * 1e6);
+	printf("Latency p99.9:    %.1f us\n", get_percentile(99.9) * 1e6);
+	printf("Latency max:      %.1f us\n", get_percentile(100.0) * 1e6);
+	if (limiter)
+		printf("Limiter rate:     %.1f/s\n", chrony_get_limiter_rate(limiter));
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]... [ADDRESS]\n", name);
+	fprintf(stderr, "\t-n NUMBER\tnumber of sessions (1)\n");
+	fprintf(stderr, "\t-r RATE\t\ttarget rate of reports per second (10)\n");
+	fprintf(stderr, "\t-m MIX\t\tcomma-separated reports with optional :weight"
+		" (tracking)\n");
+	fprintf(stderr, "\t-t SECONDS\tduration of the test (10)\n");
+	fprintf(stderr, "\t-T SECONDS\ttimeout of requests (1)\n");
+	fprintf(stderr, "\t-L RATE\t\tlimit rate of requests in all sessions (no limit)\n");
+	fprintf(stderr, "\t-B NUMBER\tburst of requests with rate limiting (1)\n");
+}
+
+int main(int argc, char **argv) {
+	double now, start, end, next_job, deadline, delay, rate = 10.0, duration = 10.0;
+	double limit_rate = 0.0, limit_burst = 1.0;
+	int i, n, opt, next_client = 0, num_clients = 1, poll_timeout;
+	char default_mix[] = "tracking";
+	const char *address = NULL;
+	struct pollfd *pfds;
+	Client *clients;
+	char *mix_arg = NULL;
+
+	while ((opt = getopt(argc, argv, "n:r:m:t:T:L:B:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			num_clients = atoi(optarg);
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'm':
+			mix_arg = optarg;
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		case 'T':
+			timeout = atof(optarg);
+			break;
+		case 'L':
+			limit_rate = atof(optarg);
+			break;
+		case 'B':
+			limit_burst = atof(optarg);
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (optind < argc)
+		address = argv[optind];
+
+	if (num_clients < 1 || rate <= 0.0 || !parse_mix(mix_arg ? mix_arg : default_mix)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (limit_rate > 0.0 &&
+	    chrony_init_limiter(&limiter, limit_rate, limit_burst) != CHRONY_OK) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	clients = calloc(num_clients, sizeof (*clients));
+	pfds = calloc(num_clients, sizeof (*pfds));
+	if (!clients || !pfds)
+		return 1;
+
+	for (i = 0; i < num_clients; i++) {
+		clients[i].fd = chrony_open_socket(address);
+		if (clients[i].fd < 0) {
+			perror("Could not open socket");
+			return 1;
+		}
+		if (chrony_init_session(&clients[i].session, clients[i].fd) != CHRONY_OK)
+			return 1;
+		chrony_set_session_limiter(clients[i].session, limiter);
+		pfds[i].fd = clients[i].fd;
+		pfds[i].events = POLLIN;
+	}
+
+	start = next_job = get_time();
+	end = start + duration;
+
+	while ((now = get_time()) < end) {
+		/* Start jobs due by now in idle sessions (open loop) */
+		while (next_job <= now) {
+			for (i = 0; i < num_clients; i++) {
+				n = (next_client + i) % num_clients;
+				if (!clients[n].busy)
+					break;
+			}
+			if (i < num_clients) {
+				start_job(&clients[n], now);
+				next_client = (n + 1) % num_clients;
+			} else {
+				results.skipped++;
+			}
+			next_job += 1.0 / rate;
+		}
+
+		/* Handle timeouts */
+		deadline = next_job;
+		for (i = 0; i < num_clients; i++) {
+			if (!clients[i].busy)
+				continue;
+			if (clients[i].sent + timeout <= now) {
+				results.timeouts++;
+				clients[i].busy = false;
+				continue;
+			}
+			if (deadline > clients[i].sent + timeout)
+				deadline = clients[i].sent + timeout;
+			delay = chrony_get_send_delay(clients[i].session);
+			if (delay >= 0.0 && deadline > now + delay)
+				deadline = now + delay;
+		}
+
+		poll_timeout = (deadline - now) * 1000.0 + 1.0;
+		if (poll_timeout < 0)
+			poll_timeout = 0;
+
+		if (poll(pfds, num_clients, poll_timeout) < 0) {
+			perror("poll");
+			return 1;
+		}
+
+		now = get_time();
+
+		for (i = 0; i < num_clients; i++) {
+			/* Send requests queued by the limiter */
+			if (clients[i].busy && chrony_get_send_delay(clients[i].session) == 0.0) {
+				process_client(&clients[i], now);
+				continue;
+			}
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+			if (!clients[i].busy || !chrony_needs_response(clients[i].session)) {
+				/* Discard late response */
+				recv(pfds[i].fd, NULL, 0, 0);
+				continue;
+			}
+			process_client(&clients[i], now);
+		}
+	}
+
+	print_results(get_time() - start, num_clients);
+
+	for (i = 0; i < num_clients; i++) {
+		chrony_deinit_session(clients[i].session);
+		chrony_close_socket(clients[i].fd);
+	}
+
+	if (limiter)
+		chrony_deinit_limiter(limiter);
+
+	free(clients);
+	free(pfds);
+	free(results.latencies);
+
+	return 0;
+}
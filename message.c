@@ -25,15 +25,17 @@
 #include <inttypes.h>
 #include <math.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 
-#define REQUEST_HEADER_LEN 20
-#define RESPONSE_HEADER_LEN 28
-
 static int get_field_offset(const Field *fields, int field);
 
+/* Requests formatted in advance for each report, count and record */
+static RequestTemplate request_templates[MAX_REPORTS][2];
+static pthread_once_t request_templates_once = PTHREAD_ONCE_INIT;
+
 int get_response_len(const Response *response) {
 	int i;
 
@@ -45,26 +47,78 @@ int get_response_len(const Response *response) {
 	return RESPONSE_HEADER_LEN + get_field_offset(response->fields, i);
 }
 
-void format_request(Message *msg, uint32_t sequence, const Request *request,
-		    void **values, const Response *expected_responses) {
-	int i, pos, res_len, max_res_len;
+static void init_request_template(RequestTemplate *t, const Request *request,
+				  const Response *expected_responses) {
+	int i, res_len;
 
-	memset(msg, 0, sizeof (*msg));
+	memset(t, 0, sizeof (*t));
 
-	msg->msg[0] = 6; /* Protocol version */
-	msg->msg[1] = 1; /* Request type */
-	*(uint16_t *)&msg->msg[4] = htons(request->code);
-	*(uint32_t *)&msg->msg[8] = htonl(sequence);
+	if (request->code == 0)
+		return;
 
-	msg->fields = request->fields;
-	msg->len = sizeof (msg->msg);
+	t->header[0] = 6; /* Protocol version */
+	t->header[1] = 1; /* Request type */
+	*(uint16_t *)&t->header[4] = htons(request->code);
+
+	t->fields = request->fields;
 
 	for (i = 0; request->fields && request->fields[i].type != TYPE_NONE; i++) {
-		msg->num_fields = i + 1;
-		pos = get_field_position(msg, i);
-		assert(pos > 0);
+		assert(i < MAX_REQUEST_FIELDS);
+		t->positions[i] = REQUEST_HEADER_LEN + get_field_offset(request->fields, i);
+	}
+
+	t->num_fields = i;
+	t->data_len = REQUEST_HEADER_LEN + get_field_offset(request->fields, i);
+	assert(t->data_len <= REQUEST_HEADER_LEN + MAX_REQUEST_DATA_LEN);
+
+	/* Pad the request to the length of the longest expected response */
+	for (i = 0, t->len = t->data_len; i < MAX_RESPONSES; i++) {
+		res_len = get_response_len(&expected_responses[i]);
+		if (t->len < res_len)
+		       t->len = res_len;
+	}
+
+	assert(t->len <= MAX_MESSAGE_LEN);
+}
+
+static void init_request_templates(void) {
+	const Report *report;
+	int i;
+
+	assert(chrony_get_number_supported_reports() <= MAX_REPORTS);
+
+	for (i = 0; (report = get_report(i)); i++) {
+		init_request_template(&request_templates[i][0], &report->count_requests[0],
+				      report->count_responses);
+		init_request_template(&request_templates[i][1], &report->record_requests[0],
+				      report->record_responses);
+	}
+}
+
+const RequestTemplate *get_request_template(int report, bool count) {
+	if (report < 0 || report >= chrony_get_number_supported_reports())
+		return NULL;
+
+	pthread_once(&request_templates_once, init_request_templates);
+
+	return &request_templates[report][count ? 0 : 1];
+}
 
-		switch (msg->fields[i].type) {
+void format_request(Message *msg, uint32_t sequence, const RequestTemplate *request,
+		    void **values) {
+	int i, pos;
+
+	/* Only the header and data of the request are written. The padding
+	   is expected to be zero since the first use of the message. */
+	memcpy(msg->msg, request->header, REQUEST_HEADER_LEN);
+	*(uint32_t *)&msg->msg[8] = htonl(sequence);
+	memset(msg->msg + request->data_len, 0,
+	       REQUEST_HEADER_LEN + MAX_REQUEST_DATA_LEN - request->data_len);
+
+	for (i = 0; i < request->num_fields; i++) {
+		pos = request->positions[i];
+
+		switch (request->fields[i].type) {
 		case TYPE_UINT32:
 			*(uint32_t *)(msg->msg + pos) = htonl(*(uint32_t *)values[i]);
 			break;
@@ -76,35 +130,41 @@ void format_request(Message *msg, uint32_t sequence, const Request *request,
 		}
 	}
 
-	msg->num_fields++;
-	msg->len = get_field_position(msg, i);
-	msg->num_fields--;
+	msg->fields = request->fields;
+	msg->num_fields = request->num_fields;
+	msg->len = request->len;
+}
 
-	for (i = max_res_len = 0; i < MAX_RESPONSES; i++) {
-		res_len = get_response_len(&expected_responses[i]);
-		if (max_res_len < res_len)
-		       max_res_len = res_len;
-	}
+/* Get the length of the request padded to the length of the response
+   expected from the server if known, or the longest supported response */
+int get_request_len(const RequestTemplate *request, const Schema *schema) {
+	if (!schema || !schema->fields)
+		return request->len;
 
-	if (msg->len < max_res_len)
-		msg->len = max_res_len;
+	return schema->len > request->data_len ? schema->len : request->data_len;
 }
 
 bool is_response_valid(const Message *request, const Message *response) {
+	return is_response_header_valid(request->msg, response);
+}
+
+bool is_response_header_valid(const char *request_header, const Message *response) {
 	if (response->len < RESPONSE_HEADER_LEN ||
 	    response->msg[0] != 6 ||	/* Version */
 	    response->msg[1] != 2 ||	/* Response type */
 	    response->msg[2] != 0 ||	/* Reserved */
 	    response->msg[3] != 0 ||	/* Reserved */
-	    *(uint16_t *)&response->msg[4] != *(uint16_t *)&request->msg[4] || /* Code */
-	    *(uint32_t *)&response->msg[16] != *(uint32_t *)&request->msg[8])  /* Sequence */
+	    *(uint16_t *)&response->msg[4] != *(uint16_t *)&request_header[4] || /* Code */
+	    *(uint32_t *)&response->msg[16] != *(uint32_t *)&request_header[8])  /* Sequence */
 		return false;
 
 	return true;
 }
 
-chrony_err process_response(Message *msg, const Response *expected_responses) {
+chrony_err process_response(Message *msg, const Response *expected_responses,
+			    Schema *schema) {
 	int i, code, status;
+	chrony_err r;
 
 	msg->num_fields = 0;
 	msg->fields = NULL;
@@ -114,19 +174,44 @@ chrony_err process_response(Message *msg, const Response *expected_responses) {
 
 	switch (status) {
 	case 0: /* OK */
+		r = CHRONY_OK;
 		break;
 	case 2: /* Unauthorized */
-		return CHRONY_UNAUTHORIZED;
+		r = CHRONY_UNAUTHORIZED;
+		break;
 	case 3: /* Invalid */
-		return CHRONY_OLD_SERVER;
+		r = CHRONY_OLD_SERVER;
+		break;
 	case 6: /* Not enabled */
 	case 13:/* No RTC */
-		return CHRONY_DISABLED;
+		r = CHRONY_DISABLED;
+		break;
 	case 18:/* Bad packet version */
 	case 19:/* Bad packet length */
+		/* The request might be too short for a new server */
+		if (schema)
+			schema->fields = NULL;
 		return CHRONY_NEW_SERVER;
 	default:
-		return CHRONY_UNEXPECTED_STATUS;
+		r = CHRONY_UNEXPECTED_STATUS;
+		break;
+	}
+
+	if (schema) {
+		schema->accepted = r == CHRONY_OK || r == CHRONY_UNEXPECTED_STATUS;
+		schema->rejected = schema->accepted ? CHRONY_OK : r;
+	}
+
+	if (r != CHRONY_OK)
+		return r;
+
+	/* Use the response of the server known from a previous response */
+	if (schema && schema->fields && code == schema->code) {
+		if (msg->len < schema->len)
+			return CHRONY_INVALID_RESPONSE;
+		msg->fields = schema->fields;
+		msg->num_fields = schema->num_fields;
+		return CHRONY_OK;
 	}
 
 	for (i = 0; i < MAX_RESPONSES && expected_responses[i].fields; i++) {
@@ -148,12 +233,20 @@ chrony_err process_response(Message *msg, const Response *expected_responses) {
 		msg->fields = NULL;
 		return CHRONY_INVALID_RESPONSE;
 	}
+
+	if (schema) {
+		schema->fields = msg->fields;
+		schema->code = code;
+		schema->num_fields = i;
+		schema->len = get_field_position(msg, i);
+	}
+
 	msg->num_fields--;
 
 	return CHRONY_OK;
 }
 
-static int get_field_len(const Field *fields, int field) {
+int get_field_len(const Field *fields, int field) {
 	if (!fields)
 		return 0;
 	switch (fields[field].type) {
@@ -197,6 +290,37 @@ int get_field_position(const Message *msg, int field) {
 		get_field_offset(msg->fields, field);
 }
 
+int diff_message_fields(const Message *msg1, const Message *msg2, int data_len,
+			int *fields, int max_fields) {
+	int i, n, len, position;
+
+	/* The records need to have the same layout of fields */
+	if (!msg1->fields || msg1->fields != msg2->fields)
+		return -1;
+
+	/* Most records don't change between requests */
+	if (memcmp(msg1->msg + RESPONSE_HEADER_LEN, msg2->msg + RESPONSE_HEADER_LEN, data_len) == 0)
+		return 0;
+
+	for (i = n = 0, position = RESPONSE_HEADER_LEN; i < msg1->num_fields;
+	     position += len, i++) {
+		len = get_field_len(msg1->fields, i);
+
+		/* Ignore reserved fields */
+		if (msg1->fields[i].reserved)
+			continue;
+
+		if (memcmp(msg1->msg + position, msg2->msg + position, len) == 0)
+			continue;
+
+		if (n < max_fields)
+			fields[n] = i;
+		n++;
+	}
+
+	return n;
+}
+
 FieldType resolve_field_type(const Message *msg, int field) {
 	if (!msg->fields || field < 0 || field >= msg->num_fields)
 		return TYPE_NONE;
@@ -251,6 +375,81 @@ chrony_field_content resolve_field_content(const Message *msg, int field) {
 	return content;
 }
 
+static uint64_t read_uint64(const char *data) {
+	return (uint64_t)ntohl(*(uint32_t *)data) << 32 | ntohl(*(uint32_t *)(data + 4));
+}
+
+static uint32_t read_uint32(const char *data) {
+	return ntohl(*(uint32_t *)data);
+}
+
+static uint16_t read_uint16(const char *data) {
+	return ntohs(*(uint16_t *)data);
+}
+
+static uint8_t read_uint8(const char *data) {
+	return *data;
+}
+
+static int16_t read_int16(const char *data) {
+	return ntohs(*(uint16_t *)data);
+}
+
+static int8_t read_int8(const char *data) {
+	return *data;
+}
+
+static double read_float32(const char *data) {
+	int32_t exp, coef;
+	uint32_t x;
+
+	x = ntohl(*(uint32_t *)data);
+
+	exp = x >> 25;
+	if (exp >= 1 << 6)
+		exp -= 1 << 7;
+
+	coef = x % (1U << 25);
+	if (coef >= 1 << 24)
+		coef -= 1 << 25;
+
+	return ldexp(coef, exp - 25);
+}
+
+static struct timespec read_timespec(const char *data) {
+	struct timespec ts;
+
+	ts.tv_sec = read_uint64(data);
+	ts.tv_nsec = read_uint32(data + 8);
+
+	return ts;
+}
+
+static const char *read_address(const char *data, char *buf, int size) {
+	switch (ntohs(*(uint16_t *)(data + 16))) {
+	case 0:
+		return NULL;
+	case 1:
+		return inet_ntop(AF_INET, data, buf, size);
+	case 2:
+		return inet_ntop(AF_INET6, data, buf, size);
+	case 3:
+		snprintf(buf, size, "ID#%010"PRIu32, ntohl(*(uint32_t *)data));
+		return buf;
+	default:
+		return "?";
+	}
+}
+
+static void copy_address(const char *data, char *buf, int size) {
+	const char *s = read_address(data, buf, size);
+
+	if (!s)
+		buf[0] = '\0';
+	else if (s != buf)
+		snprintf(buf, size, "%s", s);
+}
+
 uint64_t get_field_uinteger(const Message *msg, int field) {
 	int pos = get_field_position(msg, field);
 
@@ -259,14 +458,13 @@ uint64_t get_field_uinteger(const Message *msg, int field) {
 
 	switch (resolve_field_type(msg, field)) {
 	case TYPE_UINT64:
-		return ((uint64_t)ntohl(*(uint32_t *)(msg->msg + pos)) << 32) |
-			ntohl(*(uint32_t *)(msg->msg + pos + 4));
+		return read_uint64(msg->msg + pos);
 	case TYPE_UINT32:
-		return ntohl(*(uint32_t *)(msg->msg + pos));
+		return read_uint32(msg->msg + pos);
 	case TYPE_UINT16:
-		return ntohs(*(uint16_t *)(msg->msg + pos));
+		return read_uint16(msg->msg + pos);
 	case TYPE_UINT8:
-		return (uint8_t)*(msg->msg + pos);
+		return read_uint8(msg->msg + pos);
 	default:
 		return 0;
 	}
@@ -280,9 +478,9 @@ int64_t get_field_integer(const Message *msg, int field) {
 
 	switch (resolve_field_type(msg, field)) {
 	case TYPE_INT16:
-		return ntohs(*(uint16_t *)(msg->msg + pos));
+		return read_int16(msg->msg + pos);
 	case TYPE_INT8:
-		return (int8_t)*(msg->msg + pos);
+		return read_int8(msg->msg + pos);
 	default:
 		return 0;
 	}
@@ -290,25 +488,13 @@ int64_t get_field_integer(const Message *msg, int field) {
 
 double get_field_float(const Message *msg, int field) {
 	int pos = get_field_position(msg, field);
-	int32_t exp, coef;
-	uint32_t x;
 
 	if (pos < 0)
 		return FP_NAN;
 
 	switch (resolve_field_type(msg, field)) {
 	case TYPE_FLOAT:
-		x = ntohl(*(uint32_t *)(msg->msg + pos));
-
-		exp = x >> 25;
-		if (exp >= 1 << 6)
-			exp -= 1 << 7;
-
-		coef = x % (1U << 25);
-		if (coef >= 1 << 24)
-			coef -= 1 << 25;
-
-		return coef * pow(2.0, exp - 25);
+		return read_float32(msg->msg + pos);
 	default:
 		return FP_NAN;
 	}
@@ -317,74 +503,388 @@ double get_field_float(const Message *msg, int field) {
 struct timespec get_field_timespec(const Message *msg, int field) {
 	int pos = get_field_position(msg, field);
 	struct timespec ts = { 0 };
-	const char *data;
 
 	if (pos < 0)
 		return ts;
 
-	data = msg->msg + pos;
-
 	switch (resolve_field_type(msg, field)) {
 	case TYPE_TIMESPEC:
-		ts.tv_sec = (uint64_t)ntohl(*(uint32_t *)data) << 32 |
-			ntohl(*(uint32_t *)(data + 4));
-		ts.tv_nsec = ntohl(*(uint32_t *)(data + 8));
-		break;
+		return read_timespec(msg->msg + pos);
 	default:
-		break;
+		return ts;
 	}
-
-	return ts;
 }
 
 const char *get_field_string(const Message *msg, int field) {
 	int pos = get_field_position(msg, field);
 	static char buf[256];
-	const char *data;
 
 	if (pos < 0)
 		return NULL;
 
-	data = msg->msg + pos;
-
 	switch (resolve_field_type(msg, field)) {
 	case TYPE_ADDRESS:
-		switch (ntohs(*(uint16_t *)(data + 16))) {
-		case 0:
-			return NULL;
-		case 1:
-			return inet_ntop(AF_INET, data, buf, sizeof (buf));
-		case 2:
-			return inet_ntop(AF_INET6, data, buf, sizeof (buf));
-		case 3:
-			snprintf(buf, sizeof (buf), "ID#%010"PRIu32,
-				 ntohl(*(uint32_t *)data));
-			return buf;
-		default:
-			return "?";
-		}
+		return read_address(msg->msg + pos, buf, sizeof (buf));
 	default:
 		return NULL;
 	}
 }
 
-const char *get_field_constant_name(const Message *msg, int field, uint64_t value) {
-	const Constant *c;
-	int i;
+const char *get_constant_name(const Constants *constants, uint64_t value) {
+	if (!constants)
+		return NULL;
 
-	if (!msg->fields || field < 0 || field >= msg->num_fields)
+	if (constants->flags) {
+		/* Only single flags have a name */
+		if (value == 0 || (value & (value - 1)) != 0)
+			return NULL;
+		value = FLAG_BIT(value);
+	}
+
+	if (value >= constants->num_names)
 		return NULL;
 
-	c = msg->fields[field].constants;
-	if (!c)
+	return constants->names[value];
+}
+
+int get_constant_flag_names(const Constants *constants, uint64_t value,
+			    const char **names, int max_names) {
+	const char *name;
+	int i, n;
+
+	if (!constants || !constants->flags)
+		return -1;
+
+	for (i = n = 0; i < constants->num_names; i++) {
+		if (!(value & 1ULL << i) || !(name = constants->names[i]))
+			continue;
+		if (n < max_names)
+			names[n] = name;
+		n++;
+	}
+
+	return n;
+}
+
+const char *get_field_constant_name(const Message *msg, int field, uint64_t value) {
+	if (!msg->fields || field < 0 || field >= msg->num_fields)
 		return NULL;
 
-	for (i = 0; c[i].name; i++) {
-		if (value == c[i].value)
-			return c[i].name;
+	return get_constant_name(msg->fields[field].constants, value);
+}
+
+int get_field_flag_names(const Message *msg, int field, uint64_t value,
+			 const char **names, int max_names) {
+	if (!msg->fields || field < 0 || field >= msg->num_fields)
+		return -1;
+
+	return get_constant_flag_names(msg->fields[field].constants, value, names, max_names);
+}
+
+chrony_field_type get_value_type(FieldType type) {
+	switch (type) {
+	case TYPE_UINT64:
+	case TYPE_UINT32:
+	case TYPE_UINT16:
+	case TYPE_UINT8:
+		return CHRONY_TYPE_UINTEGER;
+	case TYPE_INT16:
+	case TYPE_INT8:
+		return CHRONY_TYPE_INTEGER;
+	case TYPE_FLOAT:
+		return CHRONY_TYPE_FLOAT;
+	case TYPE_ADDRESS:
+		return CHRONY_TYPE_STRING;
+	case TYPE_TIMESPEC:
+		return CHRONY_TYPE_TIMESPEC;
+	case TYPE_NONE:
+		return CHRONY_TYPE_NONE;
+	default:
+		assert(0);
+		return CHRONY_TYPE_NONE;
+	}
+}
+
+bool resolve_projected_field(const Field *fields, const char *name, ProjectedField *field) {
+	int i, position;
+
+	for (i = 0, position = RESPONSE_HEADER_LEN; fields[i].type != TYPE_NONE;
+	     position += get_field_len(fields, i), i++) {
+		if (fields[i].type == TYPE_ADDRESS_OR_UINT32_IN_ADDRESS) {
+			if (strcmp(name, fields[i].name) == 0)
+				field->resolved_type = TYPE_ADDRESS;
+			else if (strcmp(name, fields[i].name + strlen(fields[i].name) + 1) == 0)
+				field->resolved_type = TYPE_UINT32;
+			else
+				continue;
+		} else {
+			if (strcmp(name, fields[i].name) != 0)
+				continue;
+			field->resolved_type = fields[i].type;
+		}
+
+		field->index = i;
+		field->position = position;
+		field->type = fields[i].type;
+		field->value_type = get_value_type(field->resolved_type);
+		return true;
+	}
+
+	field->index = -1;
+	field->position = -1;
+	field->type = TYPE_NONE;
+	field->resolved_type = TYPE_NONE;
+	field->value_type = CHRONY_TYPE_NONE;
+
+	return false;
+}
+
+static void set_absent_value(chrony_field_value *value, chrony_field_type type) {
+	memset(value, 0, sizeof (*value));
+
+	switch (type) {
+	case CHRONY_TYPE_UINTEGER:
+		value->uinteger = CHRONY_ABSENT_UINTEGER;
+		break;
+	case CHRONY_TYPE_FLOAT:
+		value->floating = NAN;
+		break;
+	default:
+		break;
+	}
+}
+
+void read_field_value(const Message *msg, int position, FieldType type,
+		      chrony_field_type value_type, chrony_field_value *value) {
+	const char *data = msg->msg + position;
+
+	switch (type) {
+	case TYPE_UINT64:
+		value->uinteger = read_uint64(data);
+		break;
+	case TYPE_UINT32:
+		value->uinteger = read_uint32(data);
+		break;
+	case TYPE_UINT16:
+		value->uinteger = read_uint16(data);
+		break;
+	case TYPE_UINT8:
+		value->uinteger = read_uint8(data);
+		break;
+	case TYPE_INT16:
+		value->integer = read_int16(data);
+		break;
+	case TYPE_INT8:
+		value->integer = read_int8(data);
+		break;
+	case TYPE_FLOAT:
+		value->floating = read_float32(data);
+		break;
+	case TYPE_TIMESPEC:
+		value->timespec = read_timespec(data);
+		break;
+	case TYPE_ADDRESS:
+		copy_address(data, value->string, sizeof (value->string));
+		break;
+	default:
+		set_absent_value(value, value_type);
+		break;
+	}
+}
+
+void project_fields(const Message *msg, const ProjectedField *fields, int num_fields,
+		    chrony_field_value *values) {
+	FieldType type;
+	int i;
+
+	for (i = 0; i < num_fields; i++) {
+		type = fields[i].resolved_type;
+
+		/* The address or reference ID depends on the record */
+		if (fields[i].type == TYPE_ADDRESS_OR_UINT32_IN_ADDRESS &&
+		    resolve_field_type(msg, fields[i].index) != type)
+			type = TYPE_NONE;
+
+		read_field_value(msg, fields[i].position, type, fields[i].value_type, &values[i]);
+	}
+}
+
+/* Specialized decoders of records generated from the field lists in
+   reports.h. The fields are at fixed offsets given by a struct of char
+   arrays (which has no padding) and are read without looking up their
+   type and position in the Field tables. */
+
+#define WIRE_LEN_UINT64 8
+#define WIRE_LEN_UINT32 4
+#define WIRE_LEN_UINT16 2
+#define WIRE_LEN_UINT8 1
+#define WIRE_LEN_INT16 2
+#define WIRE_LEN_INT8 1
+#define WIRE_LEN_FLOAT 4
+#define WIRE_LEN_ADDRESS 20
+#define WIRE_LEN_ADDRESS_OR_UINT32_IN_ADDRESS 20
+#define WIRE_LEN_TIMESPEC 12
+
+#define DECODE_UINT64(dst, src) dst = read_uint64(src)
+#define DECODE_UINT32(dst, src) dst = read_uint32(src)
+#define DECODE_UINT16(dst, src) dst = read_uint16(src)
+#define DECODE_UINT8(dst, src) dst = read_uint8(src)
+#define DECODE_INT16(dst, src) dst = read_int16(src)
+#define DECODE_INT8(dst, src) dst = read_int8(src)
+#define DECODE_FLOAT(dst, src) dst = read_float32(src)
+#define DECODE_TIMESPEC(dst, src) dst = read_timespec(src)
+#define DECODE_ADDRESS(dst, src) copy_address(src, dst, sizeof (dst))
+
+#define WIRE_MEMBER(member, name, type, content, constants) \
+	char member[WIRE_LEN_##type];
+#define DECODE_MEMBER(member, name, type, content, constants) \
+	DECODE_##type(r->member, w->member);
+#define SKIP_MEMBER(member, name, type, content, constants)
+
+#define DEFINE_DECODER(report, fields, record) \
+	typedef struct { \
+		fields(WIRE_MEMBER, WIRE_MEMBER, WIRE_MEMBER) \
+	} report##_wire; \
+	static void decode_##report##_fields(const Message *msg, record *r) { \
+		const report##_wire *w = (const void *)(msg->msg + RESPONSE_HEADER_LEN); \
+		fields(DECODE_MEMBER, SKIP_MEMBER, SKIP_MEMBER) \
+	}
+
+DEFINE_DECODER(tracking, TRACKING_REPORT_FIELDS, chrony_tracking_record)
+DEFINE_DECODER(sources, SOURCES_REPORT_FIELDS, chrony_sources_record)
+DEFINE_DECODER(sourcestats, SOURCESTATS_REPORT_FIELDS, chrony_sourcestats_record)
+DEFINE_DECODER(selectdata, SELECTDATA_REPORT_FIELDS, chrony_selectdata_record)
+DEFINE_DECODER(activity, ACTIVITY_REPORT_FIELDS, chrony_activity_record)
+DEFINE_DECODER(authdata, AUTHDATA_REPORT_FIELDS, chrony_authdata_record)
+DEFINE_DECODER(ntpdata, NTPDATA_REPORT_FIELDS, chrony_ntpdata_record)
+DEFINE_DECODER(ntpdata2, NTPDATA2_REPORT_FIELDS, chrony_ntpdata_record)
+DEFINE_DECODER(serverstats, SERVERSTATS_REPORT_FIELDS, chrony_serverstats_record)
+DEFINE_DECODER(serverstats2, SERVERSTATS2_REPORT_FIELDS, chrony_serverstats_record)
+DEFINE_DECODER(serverstats3, SERVERSTATS3_REPORT_FIELDS, chrony_serverstats_record)
+DEFINE_DECODER(serverstats4, SERVERSTATS4_REPORT_FIELDS, chrony_serverstats_record)
+DEFINE_DECODER(rtcdata, RTCDATA_REPORT_FIELDS, chrony_rtcdata_record)
+DEFINE_DECODER(smoothing, SMOOTHING_REPORT_FIELDS, chrony_smoothing_record)
+
+bool decode_tracking_record(const Message *msg, chrony_tracking_record *r) {
+	if (msg->fields != tracking_report_fields)
+		return false;
+
+	decode_tracking_fields(msg, r);
+
+	return true;
+}
+
+bool decode_sources_record(const Message *msg, chrony_sources_record *r) {
+	const sources_wire *w = (const void *)(msg->msg + RESPONSE_HEADER_LEN);
+
+	if (msg->fields != sources_report_fields)
+		return false;
+
+	decode_sources_fields(msg, r);
+
+	/* Reference clocks have the reference ID in the address */
+	if (r->mode == 2) {
+		r->address[0] = '\0';
+		r->reference_id = read_uint32(w->address_or_reference_id);
+	} else {
+		copy_address(w->address_or_reference_id, r->address, sizeof (r->address));
+		r->reference_id = CHRONY_ABSENT_UINTEGER;
+	}
+
+	return true;
+}
+
+bool decode_sourcestats_record(const Message *msg, chrony_sourcestats_record *r) {
+	if (msg->fields != sourcestats_report_fields)
+		return false;
+
+	decode_sourcestats_fields(msg, r);
+
+	return true;
+}
+
+bool decode_selectdata_record(const Message *msg, chrony_selectdata_record *r) {
+	if (msg->fields != selectdata_report_fields)
+		return false;
+
+	decode_selectdata_fields(msg, r);
+
+	return true;
+}
+
+bool decode_activity_record(const Message *msg, chrony_activity_record *r) {
+	if (msg->fields != activity_report_fields)
+		return false;
+
+	decode_activity_fields(msg, r);
+
+	return true;
+}
+
+bool decode_authdata_record(const Message *msg, chrony_authdata_record *r) {
+	if (msg->fields != authdata_report_fields)
+		return false;
+
+	decode_authdata_fields(msg, r);
+
+	return true;
+}
+
+bool decode_ntpdata_record(const Message *msg, chrony_ntpdata_record *r) {
+	if (msg->fields == ntpdata2_report_fields) {
+		decode_ntpdata2_fields(msg, r);
+	} else if (msg->fields == ntpdata_report_fields) {
+		decode_ntpdata_fields(msg, r);
+		r->kernel_transmit_timestamps = CHRONY_ABSENT_UINTEGER;
+		r->kernel_receive_timestamps = CHRONY_ABSENT_UINTEGER;
+		r->hardware_transmit_timestamps = CHRONY_ABSENT_UINTEGER;
+		r->hardware_receive_timestamps = CHRONY_ABSENT_UINTEGER;
+	} else {
+		return false;
 	}
 
-	return NULL;
+	return true;
+}
+
+bool decode_serverstats_record(const Message *msg, chrony_serverstats_record *r) {
+	if (msg->fields != serverstats_report_fields &&
+	    msg->fields != serverstats2_report_fields &&
+	    msg->fields != serverstats3_report_fields &&
+	    msg->fields != serverstats4_report_fields)
+		return false;
+
+	/* Mark counters missing in older versions of the report, all members
+	   are uint64_t and CHRONY_ABSENT_UINTEGER has all bits set */
+	memset(r, 0xff, sizeof (*r));
+
+	if (msg->fields == serverstats4_report_fields)
+		decode_serverstats4_fields(msg, r);
+	else if (msg->fields == serverstats3_report_fields)
+		decode_serverstats3_fields(msg, r);
+	else if (msg->fields == serverstats2_report_fields)
+		decode_serverstats2_fields(msg, r);
+	else
+		decode_serverstats_fields(msg, r);
+
+	return true;
+}
+
+bool decode_rtcdata_record(const Message *msg, chrony_rtcdata_record *r) {
+	if (msg->fields != rtcdata_report_fields)
+		return false;
+
+	decode_rtcdata_fields(msg, r);
+
+	return true;
+}
+
+bool decode_smoothing_record(const Message *msg, chrony_smoothing_record *r) {
+	if (msg->fields != smoothing_report_fields)
+		return false;
+
+	decode_smoothing_fields(msg, r);
+
+	return true;
 }
 
 int get_report_index(const char *name) {
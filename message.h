@@ -21,9 +21,21 @@
 
 #include "chrony.h"
 
-#define MAX_MESSAGE_LEN 1024
+#include <netinet/in.h>
+
+/* Maximum length of requests and responses of the supported reports (the
+   requests are padded to the length of the longest response, which is
+   checked in the request templates). A response cannot be longer than the
+   request. */
+#define MAX_MESSAGE_LEN 256
 #define MAX_REQUESTS 2
 #define MAX_RESPONSES 4
+#define MAX_REPORTS 16
+
+#define REQUEST_HEADER_LEN 20
+#define RESPONSE_HEADER_LEN 28
+#define MAX_REQUEST_FIELDS 2
+#define MAX_REQUEST_DATA_LEN 32
 
 typedef enum {
 	TYPE_NONE = 0,
@@ -47,11 +59,27 @@ typedef struct {
 	const char *name;
 } Constant;
 
+typedef struct {
+	/* List of the constants terminated by an entry with a NULL name */
+	const Constant *list;
+	/* Names indexed by the value of an enum, or the bit of a flag */
+	const char *const *names;
+	int num_names;
+	bool flags;
+} Constants;
+
+/* Index of the bit of a single flag (a constant expression) */
+#define FLAG_BIT(flag) \
+	(((flag) & 0xffffffff00000000ULL ? 32 : 0) + ((flag) & 0xffff0000ffff0000ULL ? 16 : 0) + \
+	 ((flag) & 0xff00ff00ff00ff00ULL ? 8 : 0) + ((flag) & 0xf0f0f0f0f0f0f0f0ULL ? 4 : 0) + \
+	 ((flag) & 0xccccccccccccccccULL ? 2 : 0) + ((flag) & 0xaaaaaaaaaaaaaaaaULL ? 1 : 0))
+
 typedef struct {
 	const char *name;
 	FieldType type;
 	chrony_field_content content;
-	const Constant *constants;
+	const Constants *constants;
+	bool reserved;
 } Field;
 
 typedef struct {
@@ -79,12 +107,55 @@ typedef struct {
 	const Field *fields;
 } Message;
 
-void format_request(Message *msg, uint32_t sequence, const Request *request,
-		    void **values, const Response *expected_responses);
+/* Response of a server to a request learned from a previous response,
+   which allows later responses to be processed without looking up the
+   expected response and counting the fields */
+typedef struct {
+	const Field *fields;
+	uint16_t code;
+	uint16_t num_fields;
+	/* Minimum length of the response */
+	uint16_t len;
+	/* Request accepted by the server (even if the response has an error
+	   status, e.g. an invalid index), or the error of a rejected request
+	   (unknown, not authorized, or disabled) */
+	bool accepted;
+	chrony_err rejected;
+} Schema;
+
+typedef struct {
+	/* Index and position in the message of the field, or -1 if missing */
+	int index;
+	int position;
+	FieldType type;
+	/* Type of the field after resolving the address or reference ID */
+	FieldType resolved_type;
+	chrony_field_type value_type;
+} ProjectedField;
+
+typedef struct {
+	char header[REQUEST_HEADER_LEN];
+	const Field *fields;
+	int num_fields;
+	int positions[MAX_REQUEST_FIELDS];
+	int data_len;
+	int len;
+} RequestTemplate;
+
+int get_response_len(const Response *response);
+const RequestTemplate *get_request_template(int report, bool count);
+void format_request(Message *msg, uint32_t sequence, const RequestTemplate *request,
+		    void **values);
+int get_request_len(const RequestTemplate *request, const Schema *schema);
 bool is_response_valid(const Message *request, const Message *response);
-chrony_err process_response(Message *response, const Response *expected_responses);
+bool is_response_header_valid(const char *request_header, const Message *response);
+chrony_err process_response(Message *response, const Response *expected_responses,
+			    Schema *schema);
 
+int get_field_len(const Field *fields, int field);
 int get_field_position(const Message *msg, int field);
+int diff_message_fields(const Message *msg1, const Message *msg2, int data_len,
+			int *fields, int max_fields);
 
 FieldType resolve_field_type(const Message *msg, int field);
 const char *resolve_field_name(const Message *msg, int field);
@@ -95,12 +166,57 @@ int64_t get_field_integer(const Message *msg, int field);
 double get_field_float(const Message *msg, int field);
 struct timespec get_field_timespec(const Message *msg, int field);
 const char *get_field_string(const Message *msg, int field);
+const char *get_constant_name(const Constants *constants, uint64_t value);
+int get_constant_flag_names(const Constants *constants, uint64_t value,
+			    const char **names, int max_names);
 const char *get_field_constant_name(const Message *msg, int field, uint64_t value);
+int get_field_flag_names(const Message *msg, int field, uint64_t value,
+			 const char **names, int max_names);
+chrony_field_type get_value_type(FieldType type);
+
+bool resolve_projected_field(const Field *fields, const char *name, ProjectedField *field);
+void read_field_value(const Message *msg, int position, FieldType type,
+		      chrony_field_type value_type, chrony_field_value *value);
+void project_fields(const Message *msg, const ProjectedField *fields, int num_fields,
+		    chrony_field_value *values);
+
+bool decode_tracking_record(const Message *msg, chrony_tracking_record *record);
+bool decode_sources_record(const Message *msg, chrony_sources_record *record);
+bool decode_sourcestats_record(const Message *msg, chrony_sourcestats_record *record);
+bool decode_selectdata_record(const Message *msg, chrony_selectdata_record *record);
+bool decode_activity_record(const Message *msg, chrony_activity_record *record);
+bool decode_authdata_record(const Message *msg, chrony_authdata_record *record);
+bool decode_ntpdata_record(const Message *msg, chrony_ntpdata_record *record);
+bool decode_serverstats_record(const Message *msg, chrony_serverstats_record *record);
+bool decode_rtcdata_record(const Message *msg, chrony_rtcdata_record *record);
+bool decode_smoothing_record(const Message *msg, chrony_smoothing_record *record);
 
 int get_report_index(const char *name);
 const Report *get_report(int report);
 bool is_report_fields(const char *report_name, const Field *fields);
 
+double reserve_limiter_token(chrony_limiter *l, double now);
+void increase_limiter_rate(chrony_limiter *l);
+void decrease_limiter_rate(chrony_limiter *l, double send_time, double now);
+
+typedef union {
+	struct sockaddr_in in4;
+	struct sockaddr_in6 in6;
+	struct sockaddr sa;
+} SocketAddress;
+
+bool parse_inet_address(const char *address, SocketAddress *sa);
+
+chrony_err add_multiplexer_session(chrony_multiplexer *m, chrony_session *s,
+				   const char *address, int *entry);
+void remove_multiplexer_session(chrony_multiplexer *m, int entry);
+int get_multiplexer_fd(chrony_multiplexer *m);
+int send_multiplexed_message(chrony_multiplexer *m, int entry, const char *msg, int len);
+bool is_session_response(chrony_session *s, const char *msg, int len);
+chrony_err process_multiplexed_message(chrony_session *s, const char *msg, int len);
+
+const Message *get_session_record(chrony_session *s);
+
 int chrony_get_number_supported_reports(void);
 const char *chrony_get_report_name(int report);
 
@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Mock chronyd command server responding to all requests supported by
+   the library with synthetic data, for testing and load testing without
+   a real chronyd */
+
+#include "synth.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_DELAYED 4096
+
+typedef struct {
+	union {
+		struct sockaddr_un un;
+		struct sockaddr_in in4;
+		struct sockaddr_in6 in6;
+		struct sockaddr sa;
+	} addr;
+	socklen_t len;
+} Peer;
+
+typedef struct {
+	Peer peer;
+	int fd;
+	double due;
+	int len;
+	char msg[MAX_MESSAGE_LEN];
+} Delayed;
+
+typedef struct {
+	uint64_t received;
+	uint64_t dropped;
+	uint64_t lost;
+	uint64_t responses;
+} Stats;
+
+static SynthConfig config = { .num_sources = 8, .response_variant = MAX_RESPONSES - 1 };
+static double loss;
+static double delay;
+static double rate;
+static double burst;
+static double tokens;
+static double last_token_update;
+static bool unauthorized[MAX_REPORTS];
+static bool disabled[MAX_REPORTS];
+static bool invalid[MAX_REPORTS];
+static Delayed delayed[MAX_DELAYED];
+static int num_delayed;
+static Stats stats;
+static volatile sig_atomic_t quit;
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void handle_signal(int sig) {
+	quit = 1;
+}
+
+static int open_unix_server(const char *path) {
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	if (snprintf(addr.sun_path, sizeof (addr.sun_path), "%s", path) >=
+	    sizeof (addr.sun_path)) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+
+	unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof (addr)) < 0 ||
+	    chmod(path, 0666) < 0) {
+		perror("Could not open Unix socket");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int open_udp_server(const char *address, int port) {
+	union {
+		struct sockaddr_in in4;
+		struct sockaddr_in6 in6;
+		struct sockaddr sa;
+	} sa;
+	socklen_t len;
+	int fd;
+
+	memset(&sa, 0, sizeof (sa));
+
+	if (inet_pton(AF_INET, address, &sa.in4.sin_addr) == 1) {
+		sa.in4.sin_family = AF_INET;
+		sa.in4.sin_port = htons(port);
+		len = sizeof (sa.in4);
+	} else if (inet_pton(AF_INET6, address, &sa.in6.sin6_addr) == 1) {
+		sa.in6.sin6_family = AF_INET6;
+		sa.in6.sin6_port = htons(port);
+		len = sizeof (sa.in6);
+	} else {
+		fprintf(stderr, "Invalid address %s\n", address);
+		return -1;
+	}
+
+	fd = socket(sa.sa.sa_family, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, &sa.sa, len) < 0) {
+		perror("Could not open UDP socket");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static bool take_token(double now) {
+	if (rate <= 0.0)
+		return true;
+
+	tokens += (now - last_token_update) * rate;
+	if (tokens > burst)
+		tokens = burst;
+	last_token_update = now;
+
+	if (tokens < 1.0)
+		return false;
+
+	tokens -= 1.0;
+	return true;
+}
+
+static void set_counter(Message *msg, const Report *report, const char *name, uint64_t value) {
+	int i, pos;
+
+	if (process_response(msg, report->record_responses, NULL) != CHRONY_OK)
+		return;
+
+	for (i = 0; i < msg->num_fields; i++) {
+		if (strcmp(resolve_field_name(msg, i), name) != 0)
+			continue;
+		pos = get_field_position(msg, i);
+		switch (resolve_field_type(msg, i)) {
+		case TYPE_UINT64:
+			*(uint32_t *)(msg->msg + pos) = htonl(value >> 32);
+			*(uint32_t *)(msg->msg + pos + 4) = htonl(value);
+			break;
+		case TYPE_UINT32:
+			*(uint32_t *)(msg->msg + pos) = htonl(value);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void respond(Message *response, const Message *request, bool unix_socket) {
+	const Report *report;
+	int report_index;
+	bool count;
+
+	report_index = synth_find_report(request, &count);
+	report = get_report(report_index);
+
+	if (report && report_index < MAX_REPORTS) {
+		if (unauthorized[report_index] && !unix_socket) {
+			synth_format_status(response, request, SYNTH_STATUS_UNAUTH);
+			return;
+		}
+		if (disabled[report_index] && !count) {
+			synth_format_status(response, request, SYNTH_STATUS_NOTENABLED);
+			return;
+		}
+		if (invalid[report_index] && !count) {
+			synth_format_status(response, request, SYNTH_STATUS_INVALID);
+			return;
+		}
+	}
+
+	if (!synth_respond(response, request, &config)) {
+		response->len = 0;
+		return;
+	}
+
+	/* Report our own counters in serverstats */
+	if (report && !count && strcmp(report->name, "serverstats") == 0) {
+		set_counter(response, report, "received command requests", stats.received);
+		set_counter(response, report, "dropped command requests", stats.dropped);
+	}
+}
+
+static void send_response(int fd, const char *msg, int len, const Peer *peer) {
+	if (sendto(fd, msg, len, 0, &peer->addr.sa, peer->len) < 0)
+		return;
+	stats.responses++;
+}
+
+static void receive_request(int fd, bool unix_socket) {
+	Message request, response;
+	Delayed *d;
+	double now;
+	Peer peer;
+	int len;
+
+	peer.len = sizeof (peer.addr);
+	len = recvfrom(fd, request.msg, sizeof (request.msg), 0, &peer.addr.sa, &peer.len);
+	if (len < 0)
+		return;
+	request.len = len;
+
+	stats.received++;
+	now = get_time();
+
+	if (!take_token(now)) {
+		stats.dropped++;
+		return;
+	}
+
+	if (loss > 0.0 && random() < loss * RAND_MAX) {
+		stats.lost++;
+		return;
+	}
+
+	respond(&response, &request, unix_socket);
+	if (response.len <= 0)
+		return;
+
+	if (delay <= 0.0) {
+		send_response(fd, response.msg, response.len, &peer);
+		return;
+	}
+
+	if (num_delayed >= MAX_DELAYED) {
+		stats.lost++;
+		return;
+	}
+
+	d = &delayed[num_delayed++];
+	d->peer = peer;
+	d->fd = fd;
+	d->due = now + delay;
+	d->len = response.len;
+	memcpy(d->msg, response.msg, response.len);
+}
+
+static void send_delayed(double now) {
+	int i;
+
+	/* All responses have the same delay, the oldest is first */
+	for (i = 0; i < num_delayed && delayed[i].due <= now; i++)
+		send_response(delayed[i].fd, delayed[i].msg, delayed[i].len, &delayed[i].peer);
+
+	if (i > 0) {
+		memmove(&delayed[0], &delayed[i], (num_delayed - i) * sizeof (delayed[0]));
+		num_delayed -= i;
+	}
+}
+
+static bool set_report_flag(bool *flags, const char *name) {
+	int i = get_report_index(name);
+
+	if (i < 0 || i >= MAX_REPORTS) {
+		fprintf(stderr, "Unknown report %s\n", name);
+		return false;
+	}
+	flags[i] = true;
+	return true;
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]...\n", name);
+	fprintf(stderr, "\t-s PATH\t\tpath of Unix domain socket\n");
+	fprintf(stderr, "\t-a ADDRESS\tIPv4/IPv6 address of UDP socket (127.0.0.1)\n");
+	fprintf(stderr, "\t-p PORT\t\tport of UDP socket (10323)\n");
+	fprintf(stderr, "\t-n NUMBER\tnumber of sources (8)\n");
+	fprintf(stderr, "\t-v INDEX\tmaximum response variant (3)\n");
+	fprintf(stderr, "\t-l PERCENT\tpercentage of lost requests (0)\n");
+	fprintf(stderr, "\t-d SECONDS\tdelay of responses (0)\n");
+	fprintf(stderr, "\t-r RATE\t\tmaximum rate of requests per second (no limit)\n");
+	fprintf(stderr, "\t-b NUMBER\tburst of requests with rate limiting (rate)\n");
+	fprintf(stderr, "\t-U REPORT\trespond unauthorized to report over UDP\n");
+	fprintf(stderr, "\t-D REPORT\trespond disabled to report\n");
+	fprintf(stderr, "\t-I REPORT\trespond invalid to report (as an old server)\n");
+}
+
+int main(int argc, char **argv) {
+	const char *unix_path = NULL, *address = "127.0.0.1";
+	int i, opt, port = 10323, timeout, nfds = 0;
+	struct pollfd pfds[2];
+	bool unix_socket;
+	double now;
+
+	while ((opt = getopt(argc, argv, "s:a:p:n:v:l:d:r:b:U:D:I:h")) != -1) {
+		switch (opt) {
+		case 's':
+			unix_path = optarg;
+			break;
+		case 'a':
+			address = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'n':
+			config.num_sources = atoi(optarg);
+			break;
+		case 'v':
+			config.response_variant = atoi(optarg);
+			break;
+		case 'l':
+			loss = atof(optarg) / 100.0;
+			break;
+		case 'd':
+			delay = atof(optarg);
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'b':
+			burst = atof(optarg);
+			break;
+		case 'U':
+			if (!set_report_flag(unauthorized, optarg))
+				return 1;
+			break;
+		case 'D':
+			if (!set_report_flag(disabled, optarg))
+				return 1;
+			break;
+		case 'I':
+			if (!set_report_flag(invalid, optarg))
+				return 1;
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (burst < 1.0)
+		burst = rate > 1.0 ? rate : 1.0;
+	tokens = burst;
+	last_token_update = get_time();
+
+	if (unix_path) {
+		pfds[nfds].fd = open_unix_server(unix_path);
+		pfds[nfds].events = POLLIN;
+		if (pfds[nfds++].fd < 0)
+			return 1;
+	}
+
+	if (port > 0) {
+		pfds[nfds].fd = open_udp_server(address, port);
+		pfds[nfds].events = POLLIN;
+		if (pfds[nfds++].fd < 0)
+			return 1;
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	while (!quit) {
+		now = get_time();
+		send_delayed(now);
+
+		timeout = -1;
+		if (num_delayed > 0)
+			timeout = (delayed[0].due - now) * 1000.0 + 1.0;
+
+		if (poll(pfds, nfds, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+			unix_socket = unix_path && i == 0;
+			receive_request(pfds[i].fd, unix_socket);
+		}
+	}
+
+	fprintf(stderr, "Received %"PRIu64" requests, dropped %"PRIu64", lost %"PRIu64
+		", sent %"PRIu64" responses\n",
+		stats.received, stats.dropped, stats.lost, stats.responses);
+
+	for (i = 0; i < nfds; i++)
+		close(pfds[i].fd);
+	if (unix_path)
+		unlink(unix_path);
+
+	return 0;
+}
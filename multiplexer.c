@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Multiplexing of sessions with different servers over one unconnected UDP
+   socket. The sessions are kept in a hash table indexed by the address of
+   the server and the responses are matched to the sessions by their
+   sequence number in the client code. */
+
+#include "message.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define MIN_BUCKETS 16
+
+/* IPv6 (or IPv4-mapped) address and port */
+#define KEY_LEN 18
+
+typedef struct {
+	SocketAddress address;
+	unsigned char key[KEY_LEN];
+	chrony_session *session;
+	/* Next entry in the bucket or the list of free entries (-1 at the end) */
+	int next;
+} Entry;
+
+struct chrony_multiplexer_t {
+	int fd;
+	int family;
+	Entry *entries;
+	int num_entries;
+	int free_entries;
+	int *buckets;
+	int num_buckets;
+	int num_sessions;
+	char buf[MAX_MESSAGE_LEN];
+};
+
+static bool get_address_key(const SocketAddress *sa, unsigned char *key) {
+	memset(key, 0, KEY_LEN);
+
+	switch (sa->sa.sa_family) {
+	case AF_INET:
+		key[10] = key[11] = 0xff;
+		memcpy(key + 12, &sa->in4.sin_addr, 4);
+		memcpy(key + 16, &sa->in4.sin_port, 2);
+		return true;
+	case AF_INET6:
+		memcpy(key, &sa->in6.sin6_addr, 16);
+		memcpy(key + 16, &sa->in6.sin6_port, 2);
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int get_bucket(chrony_multiplexer *m, const unsigned char *key) {
+	uint32_t hash = 2166136261U;
+	int i;
+
+	/* FNV-1a */
+	for (i = 0; i < KEY_LEN; i++)
+		hash = (hash ^ key[i]) * 16777619U;
+
+	return hash & (m->num_buckets - 1);
+}
+
+static bool resize_buckets(chrony_multiplexer *m, int num_buckets) {
+	int i, bucket, *buckets;
+
+	buckets = malloc(num_buckets * sizeof (*buckets));
+	if (!buckets)
+		return false;
+
+	free(m->buckets);
+	m->buckets = buckets;
+	m->num_buckets = num_buckets;
+
+	for (i = 0; i < num_buckets; i++)
+		buckets[i] = -1;
+
+	for (i = 0; i < m->num_entries; i++) {
+		if (!m->entries[i].session)
+			continue;
+		bucket = get_bucket(m, m->entries[i].key);
+		m->entries[i].next = buckets[bucket];
+		buckets[bucket] = i;
+	}
+
+	return true;
+}
+
+static bool add_entries(chrony_multiplexer *m) {
+	int i, num_entries;
+	Entry *entries;
+
+	num_entries = m->num_entries > 0 ? 2 * m->num_entries : MIN_BUCKETS;
+
+	entries = realloc(m->entries, num_entries * sizeof (*entries));
+	if (!entries)
+		return false;
+
+	memset(entries + m->num_entries, 0, (num_entries - m->num_entries) * sizeof (*entries));
+
+	for (i = num_entries - 1; i >= m->num_entries; i--) {
+		entries[i].next = m->free_entries;
+		m->free_entries = i;
+	}
+
+	m->entries = entries;
+	m->num_entries = num_entries;
+
+	return true;
+}
+
+chrony_err chrony_init_multiplexer(chrony_multiplexer **m, int fd) {
+	SocketAddress sa;
+	socklen_t len;
+
+	len = sizeof (sa);
+	if (getsockname(fd, &sa.sa, &len) < 0 ||
+	    (sa.sa.sa_family != AF_INET && sa.sa.sa_family != AF_INET6))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*m = calloc(1, sizeof (**m));
+	if (!*m)
+		return CHRONY_NO_MEMORY;
+
+	(*m)->fd = fd;
+	(*m)->family = sa.sa.sa_family;
+	(*m)->free_entries = -1;
+
+	if (!resize_buckets(*m, MIN_BUCKETS)) {
+		free(*m);
+		return CHRONY_NO_MEMORY;
+	}
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_multiplexer(chrony_multiplexer *m) {
+	free(m->entries);
+	free(m->buckets);
+	free(m);
+}
+
+int get_multiplexer_fd(chrony_multiplexer *m) {
+	return m->fd;
+}
+
+chrony_err add_multiplexer_session(chrony_multiplexer *m, chrony_session *s,
+				   const char *address, int *entry) {
+	SocketAddress sa;
+	Entry *e;
+	int bucket;
+
+	if (!address || !parse_inet_address(address, &sa))
+		return CHRONY_INVALID_ARGUMENT;
+
+	if (m->family == AF_INET && sa.sa.sa_family != AF_INET)
+		return CHRONY_INVALID_ARGUMENT;
+
+	/* Keep the load factor of the table below one */
+	if (m->num_sessions >= m->num_buckets && !resize_buckets(m, 2 * m->num_buckets))
+		return CHRONY_NO_MEMORY;
+
+	if (m->free_entries < 0 && !add_entries(m))
+		return CHRONY_NO_MEMORY;
+
+	*entry = m->free_entries;
+	e = &m->entries[*entry];
+	m->free_entries = e->next;
+
+	get_address_key(&sa, e->key);
+
+	/* Convert IPv4 addresses for an IPv6 socket */
+	if (m->family == AF_INET6 && sa.sa.sa_family == AF_INET) {
+		memset(&e->address, 0, sizeof (e->address));
+		e->address.in6.sin6_family = AF_INET6;
+		memcpy(&e->address.in6.sin6_addr, e->key, 16);
+		memcpy(&e->address.in6.sin6_port, e->key + 16, 2);
+	} else {
+		e->address = sa;
+	}
+
+	e->session = s;
+	bucket = get_bucket(m, e->key);
+	e->next = m->buckets[bucket];
+	m->buckets[bucket] = *entry;
+	m->num_sessions++;
+
+	return CHRONY_OK;
+}
+
+void remove_multiplexer_session(chrony_multiplexer *m, int entry) {
+	int *i;
+
+	for (i = &m->buckets[get_bucket(m, m->entries[entry].key)]; *i >= 0;
+	     i = &m->entries[*i].next) {
+		if (*i != entry)
+			continue;
+		*i = m->entries[entry].next;
+		break;
+	}
+
+	m->entries[entry].session = NULL;
+	m->entries[entry].next = m->free_entries;
+	m->free_entries = entry;
+	m->num_sessions--;
+}
+
+int send_multiplexed_message(chrony_multiplexer *m, int entry, const char *msg, int len) {
+	const SocketAddress *sa = &m->entries[entry].address;
+
+	return sendto(m->fd, msg, len, 0, &sa->sa, sa->sa.sa_family == AF_INET6 ?
+		      sizeof (sa->in6) : sizeof (sa->in4));
+}
+
+chrony_err chrony_process_multiplexer(chrony_multiplexer *m, chrony_session **s) {
+	unsigned char key[KEY_LEN];
+	SocketAddress sa;
+	socklen_t sa_len;
+	int i, len;
+	Entry *e;
+
+	*s = NULL;
+
+	sa_len = sizeof (sa);
+	len = recvfrom(m->fd, m->buf, sizeof (m->buf), 0, &sa.sa, &sa_len);
+	if (len < 0)
+		return CHRONY_RECV_FAILED;
+
+	if (sa_len > sizeof (sa) || !get_address_key(&sa, key))
+		return CHRONY_OK;
+
+	for (i = m->buckets[get_bucket(m, key)]; i >= 0; i = e->next) {
+		e = &m->entries[i];
+		if (memcmp(e->key, key, KEY_LEN) != 0 || !is_session_response(e->session, m->buf, len))
+			continue;
+
+		*s = e->session;
+		return process_multiplexed_message(e->session, m->buf, len);
+	}
+
+	/* Ignore datagrams from unknown addresses and late responses */
+	return CHRONY_OK;
+}
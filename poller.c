@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Poller of a fleet of servers using the poller of the library (see
+   chrony_init_poller()). The endpoints are sharded across the workers in
+   contiguous blocks and each round of an endpoint is added to the worker
+   which completed its previous round. */
+
+#include "chrony.h"
+
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]... ADDRESS...\n", name);
+	fprintf(stderr, "\t-w NUMBER\tnumber of worker threads (1)\n");
+	fprintf(stderr, "\t-n NUMBER\tnumber of sessions per address (1)\n");
+	fprintf(stderr, "\t-c NUMBER\tmaximum number of active sessions per worker (64)\n");
+	fprintf(stderr, "\t-r NUMBER\tnumber of rounds (1)\n");
+	fprintf(stderr, "\t-m REPORT\treport to be requested (tracking)\n");
+	fprintf(stderr, "\t-T SECONDS\ttimeout of requests (1)\n");
+	fprintf(stderr, "\t-S\t\tdisable work stealing\n");
+	fprintf(stderr, "\t-M\t\tshare one socket in each worker\n");
+}
+
+int main(int argc, char **argv) {
+	uint64_t requests = 0, errors = 0, timeouts = 0, completed = 0, *jobs;
+	int i, j, opt, num_addresses, num_endpoints, shard, *rounds_done;
+	int num_workers = 1, sessions_per_address = 1, max_active = 64, rounds = 1, flags = 0;
+	double start, duration, timeout = 1.0, *latencies;
+	const char *report = "tracking", **addresses;
+	chrony_poller_result result;
+	struct pollfd pfd;
+	chrony_poller *p;
+	chrony_err r;
+
+	while ((opt = getopt(argc, argv, "w:n:c:r:m:T:SMh")) != -1) {
+		switch (opt) {
+		case 'w':
+			num_workers = atoi(optarg);
+			break;
+		case 'n':
+			sessions_per_address = atoi(optarg);
+			break;
+		case 'c':
+			max_active = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'm':
+			report = optarg;
+			break;
+		case 'T':
+			timeout = atof(optarg);
+			break;
+		case 'S':
+			flags |= CHRONY_POLLER_NO_STEALING;
+			break;
+		case 'M':
+			flags |= CHRONY_POLLER_MULTIPLEXING;
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	num_addresses = argc - optind;
+	addresses = (const char **)argv + optind;
+	num_endpoints = num_addresses * sessions_per_address;
+
+	if (num_addresses < 1 || num_workers < 1 || sessions_per_address < 1 ||
+	    max_active < 1 || rounds < 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	latencies = malloc((size_t)num_endpoints * rounds * sizeof (*latencies));
+	rounds_done = calloc(num_endpoints, sizeof (*rounds_done));
+	jobs = calloc(num_workers, sizeof (*jobs));
+	if (!latencies || !rounds_done || !jobs)
+		return 1;
+
+	r = chrony_init_poller(&p, report, num_workers, max_active, timeout, flags);
+	if (r != CHRONY_OK) {
+		fprintf(stderr, "Could not create poller: %s\n", chrony_get_error_string(r));
+		return 1;
+	}
+
+	start = get_time();
+
+	/* Static sharding in contiguous blocks of endpoints */
+	shard = (num_endpoints + num_workers - 1) / num_workers;
+	for (i = 0; i < num_endpoints; i++) {
+		if (chrony_add_poller_job(p, addresses[i / sessions_per_address], i,
+					  i / shard) != CHRONY_OK)
+			return 1;
+	}
+
+	pfd.fd = chrony_get_poller_fd(p);
+	pfd.events = POLLIN;
+
+	while (completed < (uint64_t)num_endpoints * rounds) {
+		if (!chrony_pop_poller_result(p, &result)) {
+			poll(&pfd, 1, 1000);
+			continue;
+		}
+
+		/* The next round of the endpoint stays with the worker */
+		if (++rounds_done[result.id] < rounds &&
+		    chrony_add_poller_job(p, addresses[result.id / sessions_per_address],
+					  result.id, result.worker) != CHRONY_OK)
+			return 1;
+
+		jobs[result.worker]++;
+		requests += result.requests;
+		if (result.timeout)
+			timeouts++;
+		else if (result.error != CHRONY_OK)
+			errors++;
+		else
+			latencies[completed - timeouts - errors] = result.duration;
+		completed++;
+	}
+
+	duration = get_time() - start;
+
+	j = completed - timeouts - errors;
+	qsort(latencies, j, sizeof (*latencies), compare_doubles);
+
+	printf("Endpoints:        %d\n", num_endpoints);
+	printf("Workers:          %d%s%s\n", num_workers,
+	       flags & CHRONY_POLLER_NO_STEALING ? " (no stealing)" : "",
+	       flags & CHRONY_POLLER_MULTIPLEXING ? " (multiplexing)" : "");
+	printf("Duration:         %.3f s\n", duration);
+	printf("Jobs:             %"PRIu64" (%.1f/s)\n", completed, completed / duration);
+	printf("Requests:         %"PRIu64" (%.1f/s)\n", requests, requests / duration);
+	printf("Timeouts:         %"PRIu64"\n", timeouts);
+	printf("Errors:           %"PRIu64"\n", errors);
+	if (j > 0) {
+		printf("Job time p50:     %.1f us\n", latencies[j / 2] * 1e6);
+		printf("Job time max:     %.1f us\n", latencies[j - 1] * 1e6);
+	}
+	for (i = 0; i < num_workers; i++)
+		printf("Worker %-3d        %"PRIu64" jobs, %"PRIu64" stolen\n", i,
+		       jobs[i], chrony_get_poller_stolen_jobs(p, i));
+
+	chrony_deinit_poller(p);
+	free(latencies);
+	free(rounds_done);
+	free(jobs);
+
+	return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Replay of a capture (see chrony_set_session_capture()) through the
+   library at full speed. The captured requests are converted to calls of
+   the library and its requests are answered with the captured responses
+   to the same requests. The responses can be also saved as a corpus for
+   the fuzz-message target. */
+
+#include "synth.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+	double time;
+	Message msg;
+} Record;
+
+typedef struct {
+	const Message *request;
+	/* First valid response to the request, NULL if none was captured */
+	const Message *response;
+	bool used;
+} Exchange;
+
+typedef struct {
+	int report;
+	bool count;
+	int record;
+} Job;
+
+typedef struct {
+	Record *records;
+	int num_records;
+	Exchange *exchanges;
+	int num_exchanges;
+	int next_exchange;
+	Job *jobs;
+	int num_jobs;
+} Capture;
+
+static bool quiet;
+static uint64_t num_requests;
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool load_capture(Capture *c, const char *path) {
+	uint32_t sec, nsec;
+	Record *records;
+	int max_records = 0;
+	uint16_t len;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+
+	while (fread(&len, sizeof (len), 1, f) == 1 && fread(&sec, sizeof (sec), 1, f) == 1 &&
+	       fread(&nsec, sizeof (nsec), 1, f) == 1) {
+		len = ntohs(len);
+		if (len < 8 || len - 8 > MAX_MESSAGE_LEN)
+			break;
+
+		if (c->num_records >= max_records) {
+			max_records = max_records ? 2 * max_records : 256;
+			records = realloc(c->records, max_records * sizeof (*records));
+			if (!records) {
+				fclose(f);
+				return false;
+			}
+			c->records = records;
+		}
+
+		records = &c->records[c->num_records];
+		memset(records, 0, sizeof (*records));
+		records->time = ntohl(sec) + ntohl(nsec) / 1e9;
+		records->msg.len = len - 8;
+		if (records->msg.len > 0 && fread(records->msg.msg, records->msg.len, 1, f) != 1)
+			break;
+		c->num_records++;
+	}
+
+	fclose(f);
+
+	return true;
+}
+
+static bool is_request(const Message *msg) {
+	return msg->len >= REQUEST_HEADER_LEN && msg->msg[1] == 1;
+}
+
+static bool is_same_request(const Message *r1, const Message *r2) {
+	/* Compare everything except the sequence number */
+	return r1->len == r2->len && memcmp(r1->msg, r2->msg, 8) == 0 &&
+		memcmp(r1->msg + 12, r2->msg + 12, r1->len - 12) == 0;
+}
+
+static bool find_exchanges(Capture *c) {
+	int i, j;
+
+	c->exchanges = calloc(c->num_records, sizeof (*c->exchanges));
+	if (!c->exchanges)
+		return false;
+
+	for (i = 0; i < c->num_records; i++) {
+		if (!is_request(&c->records[i].msg))
+			continue;
+
+		c->exchanges[c->num_exchanges].request = &c->records[i].msg;
+
+		for (j = i + 1; j < c->num_records; j++) {
+			if (!is_request(&c->records[j].msg) &&
+			    is_response_valid(&c->records[i].msg, &c->records[j].msg)) {
+				c->exchanges[c->num_exchanges].response = &c->records[j].msg;
+				break;
+			}
+		}
+
+		c->num_exchanges++;
+	}
+
+	return true;
+}
+
+/* Find the index of the source with an address in a sourcestats response */
+static int find_source_index(Capture *c, int exchange, const char *address) {
+	const Exchange *e;
+	int i, report;
+	bool count;
+
+	report = get_report_index("sourcestats");
+
+	for (i = exchange - 1; i >= 0; i--) {
+		e = &c->exchanges[i];
+		if (!e->response || synth_find_report(e->request, &count) != report || count ||
+		    e->response->len < RESPONSE_HEADER_LEN + 4 + 20 ||
+		    memcmp(e->response->msg + RESPONSE_HEADER_LEN + 4, address, 20) != 0)
+			continue;
+		return ntohl(*(uint32_t *)(e->request->msg + REQUEST_HEADER_LEN));
+	}
+
+	return -1;
+}
+
+static bool find_jobs(Capture *c) {
+	const Message *request;
+	const Field *fields;
+	int i, report;
+	Job *job;
+	bool count;
+
+	c->jobs = calloc(c->num_exchanges, sizeof (*c->jobs));
+	if (!c->jobs)
+		return false;
+
+	for (i = 0; i < c->num_exchanges; i++) {
+		request = c->exchanges[i].request;
+		report = synth_find_report(request, &count);
+		if (report < 0 || report >= chrony_get_number_supported_reports())
+			continue;
+
+		job = &c->jobs[c->num_jobs];
+		job->report = report;
+		job->count = count;
+		job->record = 0;
+
+		fields = get_report(report)->record_requests[0].fields;
+
+		if (!count && fields && request->len >= REQUEST_HEADER_LEN + 20) {
+			if (fields[0].type == TYPE_UINT32) {
+				job->record = ntohl(*(uint32_t *)(request->msg + REQUEST_HEADER_LEN));
+			} else {
+				/* Records requested by address (e.g. ntpdata) are
+				   requested from the library by the index of the
+				   source in the sourcestats report */
+				job->record = find_source_index(c, i, request->msg + REQUEST_HEADER_LEN);
+				if (job->record < 0)
+					continue;
+				if (c->num_jobs > 0 && !job[-1].count &&
+				    job[-1].report == get_report_index("sourcestats") &&
+				    job[-1].record == job->record) {
+					job[-1] = *job;
+					continue;
+				}
+			}
+		}
+
+		c->num_jobs++;
+	}
+
+	return true;
+}
+
+static const Exchange *find_exchange(Capture *c, const Message *request) {
+	const Exchange *last = NULL;
+	Exchange *e;
+	int i;
+
+	/* The requests are expected in the same order as in the capture */
+	for (i = 0; i < c->num_exchanges; i++) {
+		e = &c->exchanges[(c->next_exchange + i) % c->num_exchanges];
+		if (!e->response || !is_same_request(e->request, request))
+			continue;
+		if (e->used) {
+			last = e;
+			continue;
+		}
+		e->used = true;
+		c->next_exchange = (e - c->exchanges + 1) % c->num_exchanges;
+		return e;
+	}
+
+	return last;
+}
+
+static chrony_err serve_requests(Capture *c, chrony_session *s, int server_fd) {
+	Message request, response;
+	const Exchange *e;
+	chrony_err r;
+	int len;
+
+	while (chrony_needs_response(s)) {
+		len = recv(server_fd, request.msg, sizeof (request.msg), 0);
+		if (len < REQUEST_HEADER_LEN)
+			return CHRONY_RECV_FAILED;
+		request.len = len;
+		num_requests++;
+
+		e = find_exchange(c, &request);
+		if (!e)
+			return CHRONY_RECV_FAILED;
+
+		response.len = e->response->len;
+		memcpy(response.msg, e->response->msg, response.len);
+		memcpy(&response.msg[16], &request.msg[8], 4);
+
+		if (send(server_fd, response.msg, response.len, 0) < 0)
+			return CHRONY_RECV_FAILED;
+
+		r = chrony_process_response(s);
+		if (r != CHRONY_OK)
+			return r;
+	}
+
+	return CHRONY_OK;
+}
+
+static void print_record(chrony_session *s) {
+	struct timespec ts;
+	const char *str;
+	int i;
+
+	for (i = 0; i < chrony_get_record_number_fields(s); i++) {
+		if (chrony_get_field_content(s, i) == CHRONY_CONTENT_NONE)
+			continue;
+
+		printf("    %s: ", chrony_get_field_name(s, i));
+
+		switch (chrony_get_field_type(s, i)) {
+		case CHRONY_TYPE_UINTEGER:
+			printf("%"PRIu64, chrony_get_field_uinteger(s, i));
+			break;
+		case CHRONY_TYPE_INTEGER:
+			printf("%"PRId64, chrony_get_field_integer(s, i));
+			break;
+		case CHRONY_TYPE_FLOAT:
+			printf("%e", chrony_get_field_float(s, i));
+			break;
+		case CHRONY_TYPE_STRING:
+			str = chrony_get_field_string(s, i);
+			printf("%s", str ? str : "");
+			break;
+		case CHRONY_TYPE_TIMESPEC:
+			ts = chrony_get_field_timespec(s, i);
+			printf("%"PRIu64".%09"PRIu32, (uint64_t)ts.tv_sec, (uint32_t)ts.tv_nsec);
+			break;
+		default:
+			printf("?");
+			break;
+		}
+		printf("\n");
+	}
+}
+
+static int run_jobs(Capture *c, chrony_session *s, int server_fd) {
+	const char *report_name;
+	int i, errors = 0;
+	chrony_err r;
+	Job *job;
+
+	for (i = 0; i < c->num_exchanges; i++)
+		c->exchanges[i].used = false;
+	c->next_exchange = 0;
+
+	for (i = 0; i < c->num_jobs; i++) {
+		job = &c->jobs[i];
+		report_name = chrony_get_report_name(job->report);
+
+		if (job->count)
+			r = chrony_request_report_number_records(s, report_name);
+		else
+			r = chrony_request_record(s, report_name, job->record);
+		if (r == CHRONY_OK)
+			r = serve_requests(c, s, server_fd);
+
+		if (r != CHRONY_OK)
+			errors++;
+
+		if (quiet)
+			continue;
+
+		if (job->count)
+			printf("%s: number of records: ", report_name);
+		else
+			printf("%s: record #%d: ", report_name, job->record + 1);
+
+		if (r != CHRONY_OK)
+			printf("%s\n", chrony_get_error_string(r));
+		else if (job->count)
+			printf("%d\n", chrony_get_report_number_records(s));
+		else
+			printf("\n");
+
+		if (r == CHRONY_OK && !job->count)
+			print_record(s);
+	}
+
+	return errors;
+}
+
+static bool write_corpus(Capture *c, const char *dir) {
+	char path[4096];
+	unsigned char header[3];
+	const Exchange *e;
+	int i, report;
+	bool count;
+	FILE *f;
+
+	for (i = 0; i < c->num_exchanges; i++) {
+		e = &c->exchanges[i];
+		report = synth_find_report(e->request, &count);
+		if (!e->response || report < 0)
+			continue;
+
+		/* Input of the response side of the fuzz-message target */
+		header[0] = 0;
+		header[1] = report;
+		header[2] = (count ? 1 : 0) | 2;
+
+		snprintf(path, sizeof (path), "%s/capture-%d", dir, i);
+		f = fopen(path, "wb");
+		if (!f) {
+			perror(path);
+			return false;
+		}
+		if (fwrite(header, sizeof (header), 1, f) != 1 ||
+		    fwrite(e->response->msg, e->response->len, 1, f) != 1) {
+			fclose(f);
+			return false;
+		}
+		fclose(f);
+	}
+
+	return true;
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]... CAPTURE\n", name);
+	fprintf(stderr, "\t-n NUMBER\tnumber of replays (1)\n");
+	fprintf(stderr, "\t-c DIRECTORY\twrite responses as fuzz-message corpus\n");
+	fprintf(stderr, "\t-q\t\tdon't print the records\n");
+}
+
+int main(int argc, char **argv) {
+	int i, opt, fds[2], errors = 0, iterations = 1;
+	const char *corpus_dir = NULL;
+	Capture capture;
+	chrony_session *s;
+	double start, end;
+
+	while ((opt = getopt(argc, argv, "n:c:qh")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'c':
+			corpus_dir = optarg;
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (optind + 1 != argc || iterations < 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	memset(&capture, 0, sizeof (capture));
+
+	if (!load_capture(&capture, argv[optind]) || !find_exchanges(&capture) ||
+	    !find_jobs(&capture)) {
+		fprintf(stderr, "Could not load capture\n");
+		return 1;
+	}
+
+	fprintf(stderr, "Loaded %d records, %d requests, %d calls over %.3f s\n",
+		capture.num_records, capture.num_exchanges, capture.num_jobs,
+		capture.num_records > 0 ? capture.records[capture.num_records - 1].time -
+		capture.records[0].time : 0.0);
+
+	if (corpus_dir && !write_corpus(&capture, corpus_dir))
+		return 1;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	if (chrony_init_session(&s, fds[0]) != CHRONY_OK)
+		return 1;
+
+	start = get_time();
+	for (i = 0; i < iterations; i++) {
+		errors += run_jobs(&capture, s, fds[1]);
+		quiet = true;
+	}
+	end = get_time();
+
+	fprintf(stderr, "Replayed %d calls with %"PRIu64" requests in %.3f s (%.0f requests/s),"
+		" %d errors\n", iterations * capture.num_jobs, num_requests, end - start,
+		num_requests / (end - start + 1e-9), errors);
+
+	chrony_deinit_session(s);
+	close(fds[0]);
+	close(fds[1]);
+
+	free(capture.records);
+	free(capture.exchanges);
+	free(capture.jobs);
+
+	return 0;
+}
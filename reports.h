@@ -16,29 +16,63 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-static const Constant leap_enums[] = {
-	{ 0, "normal" },
-	{ 1, "insert second" },
-	{ 2, "delete second" },
-	{ 3, "not synchronized" },
-	{ 0 }
-};
+/* The constants of enums and flags are listed with an X-macro, which is
+   expanded into a list and a table of names indexed by the value of the
+   enum, or the bit of the flag, for lookups in constant time */
+
+#define CONSTANT(value, name) { value, name },
+#define ENUM_NAME(value, name) [value] = name,
+#define FLAG_NAME(value, name) [FLAG_BIT(value)] = name,
+
+#define ENUM_CONSTANTS(id, LIST) \
+	static const Constant id##_list[] = { LIST(CONSTANT) { 0 } }; \
+	static const char *const id##_names[] = { LIST(ENUM_NAME) }; \
+	static const Constants id = { id##_list, id##_names, \
+		sizeof (id##_names) / sizeof (id##_names[0]), false };
+
+#define FLAG_CONSTANTS(id, LIST) \
+	static const Constant id##_list[] = { LIST(CONSTANT) { 0 } }; \
+	static const char *const id##_names[] = { LIST(FLAG_NAME) }; \
+	static const Constants id = { id##_list, id##_names, \
+		sizeof (id##_names) / sizeof (id##_names[0]), true };
+
+#define LEAP_ENUMS(C) \
+	C(0, "normal") \
+	C(1, "insert second") \
+	C(2, "delete second") \
+	C(3, "not synchronized")
+
+ENUM_CONSTANTS(leap_enums, LEAP_ENUMS)
+
+/* The fields of records are listed with an X-macro, which is expanded
+   into the Field tables here and into the specialized decoders in
+   message.c. F() is a field with a member in the public record struct,
+   S() is a field which is skipped, or needs a special handling, and R() is
+   a reserved field, which has no meaningful value. */
+
+#define FIELD(member, name, type, content, constants) \
+	{ name, TYPE_##type, CHRONY_CONTENT_##content, constants, false },
+#define RESERVED_FIELD(member, name, type, content, constants) \
+	{ name, TYPE_##type, CHRONY_CONTENT_##content, constants, true },
+
+#define TRACKING_REPORT_FIELDS(F, S, R) \
+	F(reference_id, "reference ID", UINT32, REFERENCE_ID, NULL) \
+	F(address, "address", ADDRESS, ADDRESS, NULL) \
+	F(stratum, "stratum", UINT16, COUNT, NULL) \
+	F(leap_status, "leap status", UINT16, ENUM, &leap_enums) \
+	F(reference_time, "reference time", TIMESPEC, TIME, NULL) \
+	F(current_correction, "current correction", FLOAT, OFFSET_SECONDS, NULL) \
+	F(last_offset, "last offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(rms_offset, "RMS offset", FLOAT, MEASURE_SECONDS, NULL) \
+	F(frequency_offset, "frequency offset", FLOAT, OFFSET_PPM, NULL) \
+	F(residual_frequency, "residual frequency", FLOAT, OFFSET_PPM, NULL) \
+	F(skew, "skew", FLOAT, MEASURE_PPM, NULL) \
+	F(root_delay, "root delay", FLOAT, MEASURE_SECONDS, NULL) \
+	F(root_dispersion, "root dispersion", FLOAT, MEASURE_SECONDS, NULL) \
+	F(last_update_interval, "last update interval", FLOAT, INTERVAL_SECONDS, NULL)
 
 static const Field tracking_report_fields[] = {
-	{ "reference ID", TYPE_UINT32, CHRONY_CONTENT_REFERENCE_ID },
-	{ "address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "stratum", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "leap status", TYPE_UINT16, CHRONY_CONTENT_ENUM, leap_enums },
-	{ "reference time", TYPE_TIMESPEC, CHRONY_CONTENT_TIME },
-	{ "current correction", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "last offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "RMS offset", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "frequency offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM },
-	{ "residual frequency", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM },
-	{ "skew", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_PPM },
-	{ "root delay", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "root dispersion", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "last update interval", TYPE_FLOAT, CHRONY_CONTENT_INTERVAL_SECONDS },
+	TRACKING_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
@@ -52,102 +86,114 @@ static const Field request_by_index_fields[] = {
 	{ NULL }
 };
 
-static const Constant sources_state_enums[] = {
-	{ 0, "selected" },
-	{ 1, "nonselectable" },
-	{ 2, "falseticker" },
-	{ 3, "jittery" },
-	{ 4, "unselected" },
-	{ 5, "selectable" },
-	{ 0 }
-};
+#define SOURCES_STATE_ENUMS(C) \
+	C(0, "selected") \
+	C(1, "nonselectable") \
+	C(2, "falseticker") \
+	C(3, "jittery") \
+	C(4, "unselected") \
+	C(5, "selectable")
 
-static const Constant sources_mode_enums[] = {
-	{ 0, "client" },
-	{ 1, "peer" },
-	{ 2, "reference clock" },
-	{ 0 }
-};
+ENUM_CONSTANTS(sources_state_enums, SOURCES_STATE_ENUMS)
+
+#define SOURCES_MODE_ENUMS(C) \
+	C(0, "client") \
+	C(1, "peer") \
+	C(2, "reference clock")
+
+ENUM_CONSTANTS(sources_mode_enums, SOURCES_MODE_ENUMS)
+
+#define SOURCES_REPORT_FIELDS(F, S, R) \
+	S(address_or_reference_id, "address\0reference ID", ADDRESS_OR_UINT32_IN_ADDRESS, NONE, NULL) \
+	F(poll, "poll", INT16, INTERVAL_LOG2_SECONDS, NULL) \
+	F(stratum, "stratum", UINT16, COUNT, NULL) \
+	F(state, "state", UINT16, ENUM, &sources_state_enums) \
+	F(mode, "mode", UINT16, ENUM, &sources_mode_enums) \
+	F(flags, "flags", UINT16, NONE, NULL) \
+	F(reachability, "reachability", UINT16, BITS, NULL) \
+	F(last_sample_ago, "last sample ago", UINT32, INTERVAL_SECONDS, NULL) \
+	F(original_last_sample_offset, "original last sample offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(adjusted_last_sample_offset, "adjusted last sample offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(last_sample_error, "last sample error", FLOAT, MEASURE_SECONDS, NULL)
 
 static const Field sources_report_fields[] = {
-	{ "address\0reference ID", TYPE_ADDRESS_OR_UINT32_IN_ADDRESS, CHRONY_CONTENT_NONE },
-	{ "poll", TYPE_INT16, CHRONY_CONTENT_INTERVAL_LOG2_SECONDS },
-	{ "stratum", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "state", TYPE_UINT16, CHRONY_CONTENT_ENUM, sources_state_enums },
-	{ "mode", TYPE_UINT16, CHRONY_CONTENT_ENUM, sources_mode_enums },
-	{ "flags", TYPE_UINT16, CHRONY_CONTENT_NONE },
-	{ "reachability", TYPE_UINT16, CHRONY_CONTENT_BITS },
-	{ "last sample ago", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "original last sample offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "adjusted last sample offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "last sample error", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
+	SOURCES_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define SOURCESTATS_REPORT_FIELDS(F, S, R) \
+	F(reference_id, "reference ID", UINT32, REFERENCE_ID, NULL) \
+	F(address, "address", ADDRESS, ADDRESS, NULL) \
+	F(samples, "samples", UINT32, COUNT, NULL) \
+	F(runs, "runs", UINT32, COUNT, NULL) \
+	F(span, "span", UINT32, INTERVAL_SECONDS, NULL) \
+	F(standard_deviation, "standard deviation", FLOAT, MEASURE_SECONDS, NULL) \
+	F(residual_frequency, "residual frequency", FLOAT, OFFSET_PPM, NULL) \
+	F(skew, "skew", FLOAT, MEASURE_PPM, NULL) \
+	F(offset, "offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(offset_error, "offset error", FLOAT, MEASURE_SECONDS, NULL)
+
 static const Field sourcestats_report_fields[] = {
-	{ "reference ID", TYPE_UINT32, CHRONY_CONTENT_REFERENCE_ID },
-	{ "address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "samples", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "runs", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "span", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "standard deviation", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "residual frequency", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM },
-	{ "skew", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_PPM },
-	{ "offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "offset error", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
+	SOURCESTATS_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
-static const Constant selectdata_state_enums[] = {
-	{ 'N', "ignored" },
-	{ 's', "not synchronized" },
-	{ 'M', "missing samples" },
-	{ 'd', "unacceptable distance" },
-	{ 'D', "large distance" },
-	{ '~', "jittery" },
-	{ 'w', "waiting for others" },
-	{ 'W', "missing selectable sources" },
-	{ 'S', "stale" },
-	{ 'O', "orphan" },
-	{ 'T', "not trusted" },
-	{ 'P', "not preferred" },
-	{ 'U', "waiting for update" },
-	{ 'x', "falseticker" },
-	{ '+', "combined" },
-	{ '*', "best" },
-	{ 0 }
-};
+#define SELECTDATA_STATE_ENUMS(C) \
+	C('N', "ignored") \
+	C('s', "not synchronized") \
+	C('M', "missing samples") \
+	C('d', "unacceptable distance") \
+	C('D', "large distance") \
+	C('~', "jittery") \
+	C('w', "waiting for others") \
+	C('W', "missing selectable sources") \
+	C('S', "stale") \
+	C('O', "orphan") \
+	C('T', "not trusted") \
+	C('P', "not preferred") \
+	C('U', "waiting for update") \
+	C('x', "falseticker") \
+	C('+', "combined") \
+	C('*', "best")
 
-static const Constant selectdata_option_flags[] = {
-	{ 0x1, "noselect" },
-	{ 0x2, "prefer" },
-	{ 0x4, "trust" },
-	{ 0x8, "require" },
-	{ 0 }
-};
+ENUM_CONSTANTS(selectdata_state_enums, SELECTDATA_STATE_ENUMS)
+
+#define SELECTDATA_OPTION_FLAGS(C) \
+	C(0x1, "noselect") \
+	C(0x2, "prefer") \
+	C(0x4, "trust") \
+	C(0x8, "require")
+
+FLAG_CONSTANTS(selectdata_option_flags, SELECTDATA_OPTION_FLAGS)
+
+#define SELECTDATA_REPORT_FIELDS(F, S, R) \
+	F(reference_id, "reference ID", UINT32, REFERENCE_ID, NULL) \
+	F(address, "address", ADDRESS, ADDRESS, NULL) \
+	F(state, "state", UINT8, ENUM, &selectdata_state_enums) \
+	F(authentication, "authentication", UINT8, BOOLEAN, NULL) \
+	F(leap_status, "leap status", UINT8, ENUM, &leap_enums) \
+	R(reserved_1, "reserved #1", UINT8, NONE, NULL) \
+	F(configured_options, "configured options", UINT16, FLAGS, &selectdata_option_flags) \
+	F(effective_options, "effective options", UINT16, FLAGS, &selectdata_option_flags) \
+	F(last_sample_ago, "last sample ago", UINT32, INTERVAL_SECONDS, NULL) \
+	F(score, "score", FLOAT, RATIO, NULL) \
+	F(low_limit, "low limit", FLOAT, INTERVAL_SECONDS, NULL) \
+	F(high_limit, "high limit", FLOAT, INTERVAL_SECONDS, NULL)
 
 static const Field selectdata_report_fields[] = {
-	{ "reference ID", TYPE_UINT32, CHRONY_CONTENT_REFERENCE_ID },
-	{ "address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "state", TYPE_UINT8, CHRONY_CONTENT_ENUM, selectdata_state_enums },
-	{ "authentication", TYPE_UINT8, CHRONY_CONTENT_BOOLEAN },
-	{ "leap status", TYPE_UINT8, CHRONY_CONTENT_ENUM, leap_enums },
-	{ "reserved #1", TYPE_UINT8, CHRONY_CONTENT_NONE },
-	{ "configured options", TYPE_UINT16, CHRONY_CONTENT_FLAGS, selectdata_option_flags },
-	{ "effective options", TYPE_UINT16, CHRONY_CONTENT_FLAGS, selectdata_option_flags },
-	{ "last sample ago", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "score", TYPE_FLOAT, CHRONY_CONTENT_RATIO },
-	{ "low limit", TYPE_FLOAT, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "high limit", TYPE_FLOAT, CHRONY_CONTENT_INTERVAL_SECONDS },
+	SELECTDATA_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define ACTIVITY_REPORT_FIELDS(F, S, R) \
+	F(online_sources, "online sources", UINT32, COUNT, NULL) \
+	F(offline_sources, "offline sources", UINT32, COUNT, NULL) \
+	F(burst_online_return_sources, "burst online-return sources", UINT32, COUNT, NULL) \
+	F(burst_offline_return_sources, "burst offline-return sources", UINT32, COUNT, NULL) \
+	F(unresolved_sources, "unresolved sources", UINT32, COUNT, NULL)
+
 static const Field activity_report_fields[] = {
-	{ "online sources", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "offline sources", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "burst online-return sources", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "burst offline-return sources", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "unresolved sources", TYPE_UINT32, CHRONY_CONTENT_COUNT },
+	ACTIVITY_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
@@ -156,229 +202,256 @@ static const Field request_by_address_fields[] = {
 	{ NULL }
 };
 
-static const Constant authdata_mode_enums[] = {
-	{ 0, "none" },
-	{ 1, "symmetric key" },
-	{ 2, "NTS" },
-	{ 0 }
-};
+#define AUTHDATA_MODE_ENUMS(C) \
+	C(0, "none") \
+	C(1, "symmetric key") \
+	C(2, "NTS")
 
-static const Constant authdata_keytype_enums[] = {
-	{ 1, "MD5" },
-	{ 2, "SHA1" },
-	{ 3, "SHA256" },
-	{ 4, "SHA384" },
-	{ 5, "SHA512" },
-	{ 6, "SHA3-224" },
-	{ 7, "SHA3-256" },
-	{ 8, "SHA3-384" },
-	{ 9, "SHA3-512" },
-	{ 10, "TIGER" },
-	{ 11, "WHIRLPOOL" },
-	{ 13, "AES128" },
-	{ 14, "AES256" },
-	{ 15, "AEAD-AES-SIV-CMAC-256" },
-	{ 30, "AEAD-AES-128-GCM-SIV" },
-	{ 0 }
-};
+ENUM_CONSTANTS(authdata_mode_enums, AUTHDATA_MODE_ENUMS)
+
+#define AUTHDATA_KEYTYPE_ENUMS(C) \
+	C(1, "MD5") \
+	C(2, "SHA1") \
+	C(3, "SHA256") \
+	C(4, "SHA384") \
+	C(5, "SHA512") \
+	C(6, "SHA3-224") \
+	C(7, "SHA3-256") \
+	C(8, "SHA3-384") \
+	C(9, "SHA3-512") \
+	C(10, "TIGER") \
+	C(11, "WHIRLPOOL") \
+	C(13, "AES128") \
+	C(14, "AES256") \
+	C(15, "AEAD-AES-SIV-CMAC-256") \
+	C(30, "AEAD-AES-128-GCM-SIV")
+
+ENUM_CONSTANTS(authdata_keytype_enums, AUTHDATA_KEYTYPE_ENUMS)
+
+#define AUTHDATA_REPORT_FIELDS(F, S, R) \
+	F(mode, "mode", UINT16, ENUM, &authdata_mode_enums) \
+	F(key_type, "key type", UINT16, ENUM, &authdata_keytype_enums) \
+	F(key_id, "key ID", UINT32, INDEX, NULL) \
+	F(key_length, "key length", UINT16, LENGTH_BITS, NULL) \
+	F(key_establishment_attempts, "key establishment attempts", UINT16, COUNT, NULL) \
+	F(last_key_establishment_ago, "last key establishment ago", UINT32, INTERVAL_SECONDS, NULL) \
+	F(cookies, "cookies", UINT16, COUNT, NULL) \
+	F(cookie_length, "cookie length", UINT16, LENGTH_BYTES, NULL) \
+	F(nak, "NAK", UINT16, BOOLEAN, NULL) \
+	R(reserved_1, "reserved #1", UINT16, NONE, NULL)
 
 static const Field authdata_report_fields[] = {
-	{ "mode", TYPE_UINT16, CHRONY_CONTENT_ENUM, authdata_mode_enums },
-	{ "key type", TYPE_UINT16, CHRONY_CONTENT_ENUM, authdata_keytype_enums },
-	{ "key ID", TYPE_UINT32, CHRONY_CONTENT_INDEX },
-	{ "key length", TYPE_UINT16, CHRONY_CONTENT_LENGTH_BITS },
-	{ "key establishment attempts", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "last key establishment ago", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "cookies", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "cookie length", TYPE_UINT16, CHRONY_CONTENT_LENGTH_BYTES },
-	{ "NAK", TYPE_UINT16, CHRONY_CONTENT_BOOLEAN },
-	{ "reserved #1", TYPE_UINT16, CHRONY_CONTENT_NONE },
+	AUTHDATA_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
-static const Constant ntp_mode_enums[] = {
-	{ 1, "active symmetric" },
-	{ 2, "passive symmetric" },
-	{ 4, "server" },
-	{ 0 }
-};
+#define NTP_MODE_ENUMS(C) \
+	C(1, "active symmetric") \
+	C(2, "passive symmetric") \
+	C(4, "server")
 
-static const Constant ntp_timestamping_enums[] = {
-	{ 'D', "daemon" },
-	{ 'K', "kernel" },
-	{ 'H', "hardware" },
-	{ 0 }
-};
+ENUM_CONSTANTS(ntp_mode_enums, NTP_MODE_ENUMS)
 
-static const Constant ntp_flags[] = {
-	{ 0x200, "test1" },
-	{ 0x100, "test2" },
-	{ 0x80, "test3" },
-	{ 0x40, "test5" },
-	{ 0x20, "test6" },
-	{ 0x10, "test7" },
-	{ 0x8, "testA" },
-	{ 0x4, "testC" },
-	{ 0x2, "testB" },
-	{ 0x1, "testD" },
-	{ 0x4000, "interleaved" },
-	{ 0x8000, "authenticated" },
-	{ 0 }
-};
+#define NTP_TIMESTAMPING_ENUMS(C) \
+	C('D', "daemon") \
+	C('K', "kernel") \
+	C('H', "hardware")
+
+ENUM_CONSTANTS(ntp_timestamping_enums, NTP_TIMESTAMPING_ENUMS)
+
+#define NTP_FLAGS(C) \
+	C(0x200, "test1") \
+	C(0x100, "test2") \
+	C(0x80, "test3") \
+	C(0x40, "test5") \
+	C(0x20, "test6") \
+	C(0x10, "test7") \
+	C(0x8, "testA") \
+	C(0x4, "testC") \
+	C(0x2, "testB") \
+	C(0x1, "testD") \
+	C(0x4000, "interleaved") \
+	C(0x8000, "authenticated")
+
+FLAG_CONSTANTS(ntp_flags, NTP_FLAGS)
+
+#define NTPDATA_REPORT_FIELDS(F, S, R) \
+	F(remote_address, "remote address", ADDRESS, ADDRESS, NULL) \
+	F(local_address, "local address", ADDRESS, ADDRESS, NULL) \
+	F(remote_port, "remote port", UINT16, PORT, NULL) \
+	F(leap_status, "leap status", UINT8, ENUM, &leap_enums) \
+	F(version, "version", UINT8, COUNT, NULL) \
+	F(mode, "mode", UINT8, ENUM, &ntp_mode_enums) \
+	F(stratum, "stratum", UINT8, COUNT, NULL) \
+	F(poll, "poll", INT8, INTERVAL_LOG2_SECONDS, NULL) \
+	F(precision, "precision", INT8, INTERVAL_LOG2_SECONDS, NULL) \
+	F(root_delay, "root delay", FLOAT, MEASURE_SECONDS, NULL) \
+	F(root_dispersion, "root dispersion", FLOAT, MEASURE_SECONDS, NULL) \
+	F(reference_id, "reference ID", UINT32, REFERENCE_ID, NULL) \
+	F(reference_time, "reference time", TIMESPEC, TIME, NULL) \
+	F(offset, "offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(peer_delay, "peer delay", FLOAT, MEASURE_SECONDS, NULL) \
+	F(peer_dispersion, "peer dispersion", FLOAT, MEASURE_SECONDS, NULL) \
+	F(response_time, "response time", FLOAT, MEASURE_SECONDS, NULL) \
+	F(jitter_asymmetry, "jitter asymmetry", FLOAT, RATIO, NULL) \
+	F(flags, "flags", UINT16, FLAGS, &ntp_flags) \
+	F(transmit_timestamping, "transmit timestamping", UINT8, ENUM, &ntp_timestamping_enums) \
+	F(receive_timestamping, "receive timestamping", UINT8, ENUM, &ntp_timestamping_enums) \
+	F(transmitted_messages, "transmitted messages", UINT32, COUNT, NULL) \
+	F(received_messages, "received messages", UINT32, COUNT, NULL) \
+	F(received_valid_messages, "received valid messages", UINT32, COUNT, NULL) \
+	F(received_good_messages, "received good messages", UINT32, COUNT, NULL) \
+	R(reserved_1, "reserved #1", UINT32, NONE, NULL) \
+	R(reserved_2, "reserved #2", UINT32, NONE, NULL) \
+	R(reserved_3, "reserved #3", UINT32, NONE, NULL)
 
 static const Field ntpdata_report_fields[] = {
-	{ "remote address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "local address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "remote port", TYPE_UINT16, CHRONY_CONTENT_PORT },
-	{ "leap status", TYPE_UINT8, CHRONY_CONTENT_ENUM, leap_enums },
-	{ "version", TYPE_UINT8, CHRONY_CONTENT_COUNT },
-	{ "mode", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_mode_enums },
-	{ "stratum", TYPE_UINT8, CHRONY_CONTENT_COUNT },
-	{ "poll", TYPE_INT8, CHRONY_CONTENT_INTERVAL_LOG2_SECONDS },
-	{ "precision", TYPE_INT8, CHRONY_CONTENT_INTERVAL_LOG2_SECONDS },
-	{ "root delay", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "root dispersion", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "reference ID", TYPE_UINT32, CHRONY_CONTENT_REFERENCE_ID },
-	{ "reference time", TYPE_TIMESPEC, CHRONY_CONTENT_TIME },
-	{ "offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "peer delay", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "peer dispersion", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "response time", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "jitter asymmetry", TYPE_FLOAT, CHRONY_CONTENT_RATIO },
-	{ "flags", TYPE_UINT16, CHRONY_CONTENT_FLAGS, ntp_flags },
-	{ "transmit timestamping", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_timestamping_enums },
-	{ "receive timestamping", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_timestamping_enums },
-	{ "transmitted messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received valid messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received good messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "reserved #1", TYPE_UINT32, CHRONY_CONTENT_NONE },
-	{ "reserved #2", TYPE_UINT32, CHRONY_CONTENT_NONE },
-	{ "reserved #3", TYPE_UINT32, CHRONY_CONTENT_NONE },
+	NTPDATA_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define NTPDATA2_REPORT_FIELDS(F, S, R) \
+	F(remote_address, "remote address", ADDRESS, ADDRESS, NULL) \
+	F(local_address, "local address", ADDRESS, ADDRESS, NULL) \
+	F(remote_port, "remote port", UINT16, PORT, NULL) \
+	F(leap_status, "leap status", UINT8, ENUM, &leap_enums) \
+	F(version, "version", UINT8, COUNT, NULL) \
+	F(mode, "mode", UINT8, ENUM, &ntp_mode_enums) \
+	F(stratum, "stratum", UINT8, COUNT, NULL) \
+	F(poll, "poll", INT8, INTERVAL_LOG2_SECONDS, NULL) \
+	F(precision, "precision", INT8, INTERVAL_LOG2_SECONDS, NULL) \
+	F(root_delay, "root delay", FLOAT, MEASURE_SECONDS, NULL) \
+	F(root_dispersion, "root dispersion", FLOAT, MEASURE_SECONDS, NULL) \
+	F(reference_id, "reference ID", UINT32, REFERENCE_ID, NULL) \
+	F(reference_time, "reference time", TIMESPEC, TIME, NULL) \
+	F(offset, "offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(peer_delay, "peer delay", FLOAT, MEASURE_SECONDS, NULL) \
+	F(peer_dispersion, "peer dispersion", FLOAT, MEASURE_SECONDS, NULL) \
+	F(response_time, "response time", FLOAT, MEASURE_SECONDS, NULL) \
+	F(jitter_asymmetry, "jitter asymmetry", FLOAT, RATIO, NULL) \
+	F(flags, "flags", UINT16, FLAGS, &ntp_flags) \
+	F(transmit_timestamping, "transmit timestamping", UINT8, ENUM, &ntp_timestamping_enums) \
+	F(receive_timestamping, "receive timestamping", UINT8, ENUM, &ntp_timestamping_enums) \
+	F(transmitted_messages, "transmitted messages", UINT32, COUNT, NULL) \
+	F(received_messages, "received messages", UINT32, COUNT, NULL) \
+	F(received_valid_messages, "received valid messages", UINT32, COUNT, NULL) \
+	F(received_good_messages, "received good messages", UINT32, COUNT, NULL) \
+	F(kernel_transmit_timestamps, "kernel transmit timestamps", UINT32, COUNT, NULL) \
+	F(kernel_receive_timestamps, "kernel receive timestamps", UINT32, COUNT, NULL) \
+	F(hardware_transmit_timestamps, "hardware transmit timestamps", UINT32, COUNT, NULL) \
+	F(hardware_receive_timestamps, "hardware receive timestamps", UINT32, COUNT, NULL) \
+	R(reserved_1, "reserved #1", UINT32, NONE, NULL) \
+	R(reserved_2, "reserved #2", UINT32, NONE, NULL) \
+	R(reserved_3, "reserved #3", UINT32, NONE, NULL) \
+	R(reserved_4, "reserved #4", UINT32, NONE, NULL)
+
 static const Field ntpdata2_report_fields[] = {
-	{ "remote address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "local address", TYPE_ADDRESS, CHRONY_CONTENT_ADDRESS },
-	{ "remote port", TYPE_UINT16, CHRONY_CONTENT_PORT },
-	{ "leap status", TYPE_UINT8, CHRONY_CONTENT_ENUM, leap_enums },
-	{ "version", TYPE_UINT8, CHRONY_CONTENT_COUNT },
-	{ "mode", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_mode_enums },
-	{ "stratum", TYPE_UINT8, CHRONY_CONTENT_COUNT },
-	{ "poll", TYPE_INT8, CHRONY_CONTENT_INTERVAL_LOG2_SECONDS },
-	{ "precision", TYPE_INT8, CHRONY_CONTENT_INTERVAL_LOG2_SECONDS },
-	{ "root delay", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "root dispersion", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "reference ID", TYPE_UINT32, CHRONY_CONTENT_REFERENCE_ID },
-	{ "reference time", TYPE_TIMESPEC, CHRONY_CONTENT_TIME },
-	{ "offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "peer delay", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "peer dispersion", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "response time", TYPE_FLOAT, CHRONY_CONTENT_MEASURE_SECONDS },
-	{ "jitter asymmetry", TYPE_FLOAT, CHRONY_CONTENT_RATIO },
-	{ "flags", TYPE_UINT16, CHRONY_CONTENT_FLAGS, ntp_flags },
-	{ "transmit timestamping", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_timestamping_enums },
-	{ "receive timestamping", TYPE_UINT8, CHRONY_CONTENT_ENUM, ntp_timestamping_enums },
-	{ "transmitted messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received valid messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received good messages", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "kernel transmit timestamps", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "kernel receive timestamps", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "hardware transmit timestamps", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "hardware receive timestamps", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "reserved #1", TYPE_UINT32, CHRONY_CONTENT_NONE },
-	{ "reserved #2", TYPE_UINT32, CHRONY_CONTENT_NONE },
-	{ "reserved #3", TYPE_UINT32, CHRONY_CONTENT_NONE },
-	{ "reserved #4", TYPE_UINT32, CHRONY_CONTENT_NONE },
+	NTPDATA2_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define SERVERSTATS_REPORT_FIELDS(F, S, R) \
+	F(received_ntp_requests, "received NTP requests", UINT32, COUNT, NULL) \
+	F(received_command_requests, "received command requests", UINT32, COUNT, NULL) \
+	F(dropped_ntp_requests, "dropped NTP requests", UINT32, COUNT, NULL) \
+	F(dropped_command_requests, "dropped command requests", UINT32, COUNT, NULL) \
+	F(dropped_client_log_records, "dropped client log records", UINT32, COUNT, NULL)
+
 static const Field serverstats_report_fields[] = {
-	{ "received NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped client log records", TYPE_UINT32, CHRONY_CONTENT_COUNT },
+	SERVERSTATS_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define SERVERSTATS2_REPORT_FIELDS(F, S, R) \
+	F(received_ntp_requests, "received NTP requests", UINT32, COUNT, NULL) \
+	F(accepted_nts_ke_connections, "accepted NTS-KE connections", UINT32, COUNT, NULL) \
+	F(received_command_requests, "received command requests", UINT32, COUNT, NULL) \
+	F(dropped_ntp_requests, "dropped NTP requests", UINT32, COUNT, NULL) \
+	F(dropped_nts_ke_connections, "dropped NTS-KE connections", UINT32, COUNT, NULL) \
+	F(dropped_command_requests, "dropped command requests", UINT32, COUNT, NULL) \
+	F(dropped_client_log_records, "dropped client log records", UINT32, COUNT, NULL) \
+	F(received_authenticated_ntp_requests, "received authenticated NTP requests", UINT32, COUNT, NULL)
+
 static const Field serverstats2_report_fields[] = {
-	{ "received NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "accepted NTS-KE connections", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped NTS-KE connections", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped client log records", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received authenticated NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
+	SERVERSTATS2_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define SERVERSTATS3_REPORT_FIELDS(F, S, R) \
+	F(received_ntp_requests, "received NTP requests", UINT32, COUNT, NULL) \
+	F(accepted_nts_ke_connections, "accepted NTS-KE connections", UINT32, COUNT, NULL) \
+	F(received_command_requests, "received command requests", UINT32, COUNT, NULL) \
+	F(dropped_ntp_requests, "dropped NTP requests", UINT32, COUNT, NULL) \
+	F(dropped_nts_ke_connections, "dropped NTS-KE connections", UINT32, COUNT, NULL) \
+	F(dropped_command_requests, "dropped command requests", UINT32, COUNT, NULL) \
+	F(dropped_client_log_records, "dropped client log records", UINT32, COUNT, NULL) \
+	F(received_authenticated_ntp_requests, "received authenticated NTP requests", UINT32, COUNT, NULL) \
+	F(received_interleaved_ntp_requests, "received interleaved NTP requests", UINT32, COUNT, NULL) \
+	F(held_ntp_timestamps, "held NTP timestamps", UINT32, COUNT, NULL) \
+	F(ntp_timestamp_span, "NTP timestamp span", UINT32, INTERVAL_SECONDS, NULL)
+
 static const Field serverstats3_report_fields[] = {
-	{ "received NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "accepted NTS-KE connections", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped NTS-KE connections", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped command requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "dropped client log records", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received authenticated NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "received interleaved NTP requests", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "held NTP timestamps", TYPE_UINT32, CHRONY_CONTENT_COUNT },
-	{ "NTP timestamp span", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
+	SERVERSTATS3_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define SERVERSTATS4_REPORT_FIELDS(F, S, R) \
+	F(received_ntp_requests, "received NTP requests", UINT64, COUNT, NULL) \
+	F(accepted_nts_ke_connections, "accepted NTS-KE connections", UINT64, COUNT, NULL) \
+	F(received_command_requests, "received command requests", UINT64, COUNT, NULL) \
+	F(dropped_ntp_requests, "dropped NTP requests", UINT64, COUNT, NULL) \
+	F(dropped_nts_ke_connections, "dropped NTS-KE connections", UINT64, COUNT, NULL) \
+	F(dropped_command_requests, "dropped command requests", UINT64, COUNT, NULL) \
+	F(dropped_client_log_records, "dropped client log records", UINT64, COUNT, NULL) \
+	F(received_authenticated_ntp_requests, "received authenticated NTP requests", UINT64, COUNT, NULL) \
+	F(received_interleaved_ntp_requests, "received interleaved NTP requests", UINT64, COUNT, NULL) \
+	F(held_ntp_timestamps, "held NTP timestamps", UINT64, COUNT, NULL) \
+	F(ntp_timestamp_span, "NTP timestamp span", UINT64, INTERVAL_SECONDS, NULL) \
+	F(served_daemon_rx_timestamps, "served daemon RX timestamps", UINT64, COUNT, NULL) \
+	F(served_daemon_tx_timestamps, "served daemon TX timestamps", UINT64, COUNT, NULL) \
+	F(served_kernel_rx_timestamps, "served kernel RX timestamps", UINT64, COUNT, NULL) \
+	F(served_kernel_tx_timestamps, "served kernel TX timestamps", UINT64, COUNT, NULL) \
+	F(served_hardware_rx_timestamps, "served hardware RX timestamps", UINT64, COUNT, NULL) \
+	F(served_hardware_tx_timestamps, "served hardware TX timestamps", UINT64, COUNT, NULL) \
+	R(reserved_1, "reserved #1", UINT64, NONE, NULL) \
+	R(reserved_2, "reserved #2", UINT64, NONE, NULL) \
+	R(reserved_3, "reserved #3", UINT64, NONE, NULL) \
+	R(reserved_4, "reserved #4", UINT64, NONE, NULL)
+
 static const Field serverstats4_report_fields[] = {
-	{ "received NTP requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "accepted NTS-KE connections", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "received command requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "dropped NTP requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "dropped NTS-KE connections", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "dropped command requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "dropped client log records", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "received authenticated NTP requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "received interleaved NTP requests", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "held NTP timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "NTP timestamp span", TYPE_UINT64, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "served daemon RX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "served daemon TX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "served kernel RX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "served kernel TX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "served hardware RX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "served hardware TX timestamps", TYPE_UINT64, CHRONY_CONTENT_COUNT },
-	{ "reserved #1", TYPE_UINT64, CHRONY_CONTENT_NONE },
-	{ "reserved #2", TYPE_UINT64, CHRONY_CONTENT_NONE },
-	{ "reserved #3", TYPE_UINT64, CHRONY_CONTENT_NONE },
-	{ "reserved #4", TYPE_UINT64, CHRONY_CONTENT_NONE },
+	SERVERSTATS4_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
+#define RTCDATA_REPORT_FIELDS(F, S, R) \
+	F(reference_time, "reference time", TIMESPEC, TIME, NULL) \
+	F(samples, "samples", UINT16, COUNT, NULL) \
+	F(runs, "runs", UINT16, COUNT, NULL) \
+	F(span, "span", UINT32, INTERVAL_SECONDS, NULL) \
+	F(offset, "offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(frequency_offset, "frequency offset", FLOAT, OFFSET_PPM, NULL)
+
 static const Field rtcdata_report_fields[] = {
-	{ "reference time", TYPE_TIMESPEC, CHRONY_CONTENT_TIME },
-	{ "samples", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "runs", TYPE_UINT16, CHRONY_CONTENT_COUNT },
-	{ "span", TYPE_UINT32, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "frequency offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM },
+	RTCDATA_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
-static const Constant smoothing_flags[] = {
-	{ 0x1, "active" },
-	{ 0x2, "leaponly" },
-	{ 0 }
-};
+#define SMOOTHING_FLAGS(C) \
+	C(0x1, "active") \
+	C(0x2, "leaponly")
+
+FLAG_CONSTANTS(smoothing_flags, SMOOTHING_FLAGS)
+
+#define SMOOTHING_REPORT_FIELDS(F, S, R) \
+	F(flags, "flags", UINT32, FLAGS, &smoothing_flags) \
+	F(offset, "offset", FLOAT, OFFSET_SECONDS, NULL) \
+	F(frequency_offset, "frequency offset", FLOAT, OFFSET_PPM, NULL) \
+	F(wander, "wander", FLOAT, OFFSET_PPM_PER_SECOND, NULL) \
+	F(last_update_ago, "last update ago", FLOAT, INTERVAL_SECONDS, NULL) \
+	F(remaining_time, "remaining time", FLOAT, INTERVAL_SECONDS, NULL)
 
 static const Field smoothing_report_fields[] = {
-	{ "flags", TYPE_UINT32, CHRONY_CONTENT_FLAGS, smoothing_flags },
-	{ "offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_SECONDS },
-	{ "frequency offset", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM },
-	{ "wander", TYPE_FLOAT, CHRONY_CONTENT_OFFSET_PPM_PER_SECOND },
-	{ "last update ago", TYPE_FLOAT, CHRONY_CONTENT_INTERVAL_SECONDS },
-	{ "remaining time", TYPE_FLOAT, CHRONY_CONTENT_INTERVAL_SECONDS },
+	SMOOTHING_REPORT_FIELDS(FIELD, FIELD, RESERVED_FIELD)
 	{ NULL }
 };
 
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Scheduling of requests based on the time when new data can be expected
+   in the reports, i.e. the next update of the clock for the tracking
+   report and the next sample of a source for reports with records of
+   sources */
+
+#include "message.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	/* Due time of the number of records */
+	double count_due;
+	/* Due times of records, zero if not known yet */
+	double *record_due;
+	int num_records;
+} ReportSchedule;
+
+struct chrony_schedule_t {
+	double min_interval;
+	double max_interval;
+	ReportSchedule reports[MAX_REPORTS];
+	/* Expected time of the next sample of each source */
+	double *next_samples;
+	int num_sources;
+};
+
+static double get_monotonic_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double get_real_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double clamp_interval(chrony_schedule *sch, double interval) {
+	if (!(interval >= sch->min_interval))
+		return sch->min_interval;
+	if (interval > sch->max_interval)
+		return sch->max_interval;
+	return interval;
+}
+
+static bool is_source_report(int report) {
+	return get_report(report)->count_requests[0].code != 0;
+}
+
+static bool resize_array(double **array, int *size, int new_size) {
+	double *a;
+
+	if (new_size <= *size)
+		return true;
+
+	a = realloc(*array, new_size * sizeof (*a));
+	if (!a)
+		return false;
+
+	memset(a + *size, 0, (new_size - *size) * sizeof (*a));
+	*array = a;
+	*size = new_size;
+
+	return true;
+}
+
+chrony_err chrony_init_schedule(chrony_schedule **sch, double min_interval,
+				double max_interval) {
+	if (!(min_interval > 0.0) || !(max_interval >= min_interval))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*sch = calloc(1, sizeof (**sch));
+	if (!*sch)
+		return CHRONY_NO_MEMORY;
+
+	(*sch)->min_interval = min_interval;
+	(*sch)->max_interval = max_interval;
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_schedule(chrony_schedule *sch) {
+	int i;
+
+	for (i = 0; i < MAX_REPORTS; i++)
+		free(sch->reports[i].record_due);
+	free(sch->next_samples);
+	free(sch);
+}
+
+static chrony_err set_record_due(chrony_schedule *sch, int report, int record, double due) {
+	ReportSchedule *rs = &sch->reports[report];
+
+	if (!resize_array(&rs->record_due, &rs->num_records, record + 1))
+		return CHRONY_NO_MEMORY;
+
+	rs->record_due[record] = due;
+
+	return CHRONY_OK;
+}
+
+static chrony_err set_next_sample(chrony_schedule *sch, int source,
+				  const chrony_sources_record *record, double now) {
+	double interval;
+
+	if (!resize_array(&sch->next_samples, &sch->num_sources, source + 1))
+		return CHRONY_NO_MEMORY;
+
+	/* The source is polled at the polling interval since the last sample */
+	interval = ldexp(1.0, record->poll) - (double)record->last_sample_ago;
+	sch->next_samples[source] = now + clamp_interval(sch, interval);
+
+	return CHRONY_OK;
+}
+
+static void truncate_records(chrony_schedule *sch, int report, int num_records) {
+	ReportSchedule *rs = &sch->reports[report];
+
+	/* Forget removed sources (the arrays are reallocated when growing) */
+	if (num_records < rs->num_records)
+		rs->num_records = num_records;
+	if (report == get_report_index("sources") && num_records < sch->num_sources)
+		sch->num_sources = num_records;
+}
+
+static double get_source_due(chrony_schedule *sch, int source, double now) {
+	/* Other reports of the source change with its samples */
+	if (source < sch->num_sources && sch->next_samples[source] > now)
+		return sch->next_samples[source];
+
+	return now + sch->min_interval;
+}
+
+chrony_err chrony_update_schedule(chrony_schedule *sch, chrony_session *s,
+				  const char *report_name, int record) {
+	chrony_tracking_record tracking;
+	chrony_sources_record sources;
+	double now, interval, due;
+	int report;
+	chrony_err r;
+
+	report = get_report_index(report_name);
+	if (report < 0 || report >= MAX_REPORTS)
+		return CHRONY_UNKNOWN_REPORT;
+
+	if (record < -1)
+		return CHRONY_INVALID_ARGUMENT;
+
+	now = get_monotonic_time();
+
+	if (record < 0) {
+		/* New sources can be added at any time */
+		sch->reports[report].count_due = now + sch->max_interval;
+		truncate_records(sch, report, chrony_get_report_number_records(s));
+		return CHRONY_OK;
+	}
+
+	if (strcmp(report_name, "tracking") == 0) {
+		if (chrony_get_tracking_record(s, &tracking) != CHRONY_OK)
+			return CHRONY_INVALID_ARGUMENT;
+		/* The clock is expected to be updated after the same interval */
+		interval = tracking.reference_time.tv_sec + tracking.reference_time.tv_nsec / 1e9 +
+			tracking.last_update_interval - get_real_time();
+		due = now + clamp_interval(sch, interval);
+	} else if (strcmp(report_name, "sources") == 0) {
+		if (chrony_get_sources_record(s, &sources) != CHRONY_OK)
+			return CHRONY_INVALID_ARGUMENT;
+		r = set_next_sample(sch, record, &sources, now);
+		if (r != CHRONY_OK)
+			return r;
+		due = sch->next_samples[record];
+	} else if (is_source_report(report)) {
+		due = get_source_due(sch, record, now);
+	} else {
+		due = now + sch->max_interval;
+	}
+
+	return set_record_due(sch, report, record, due);
+}
+
+chrony_err chrony_update_schedule_source_rows(chrony_schedule *sch, chrony_session *s) {
+	static const char *report_names[] = { "sources", "sourcestats", "selectdata", "ntpdata" };
+	chrony_source_row row;
+	int i, j, report;
+	chrony_err r;
+	double now;
+
+	now = get_monotonic_time();
+
+	for (i = 0; chrony_get_source_row(s, i, &row) == CHRONY_OK; i++) {
+		r = set_next_sample(sch, i, &row.sources, now);
+		if (r != CHRONY_OK)
+			return r;
+
+		for (j = 0; j < sizeof (report_names) / sizeof (report_names[0]); j++) {
+			report = get_report_index(report_names[j]);
+			r = set_record_due(sch, report, i, sch->next_samples[i]);
+			if (r != CHRONY_OK)
+				return r;
+		}
+	}
+
+	for (j = 0; j < sizeof (report_names) / sizeof (report_names[0]); j++)
+		truncate_records(sch, get_report_index(report_names[j]), i);
+
+	sch->reports[get_report_index("sources")].count_due = now + sch->max_interval;
+
+	return CHRONY_OK;
+}
+
+static double get_record_due(chrony_schedule *sch, int report, int record) {
+	ReportSchedule *rs = &sch->reports[report];
+
+	if (record < 0)
+		return rs->count_due;
+	if (record < rs->num_records)
+		return rs->record_due[record];
+	return 0.0;
+}
+
+bool chrony_is_record_due(chrony_schedule *sch, const char *report_name, int record) {
+	int report = get_report_index(report_name);
+
+	if (report < 0 || report >= MAX_REPORTS || record < -1)
+		return false;
+
+	return get_record_due(sch, report, record) <= get_monotonic_time();
+}
+
+bool chrony_are_source_rows_due(chrony_schedule *sch) {
+	int i, report = get_report_index("sources");
+	double now = get_monotonic_time();
+	ReportSchedule *rs = &sch->reports[report];
+
+	if (rs->count_due <= now)
+		return true;
+
+	for (i = 0; i < rs->num_records; i++) {
+		if (rs->record_due[i] <= now)
+			return true;
+	}
+
+	return false;
+}
+
+double chrony_get_schedule_timeout(chrony_schedule *sch) {
+	double due, min_due = INFINITY;
+	ReportSchedule *rs;
+	int i, j;
+
+	for (i = 0; i < MAX_REPORTS; i++) {
+		rs = &sch->reports[i];
+		if (rs->count_due > 0.0 && rs->count_due < min_due)
+			min_due = rs->count_due;
+		for (j = 0; j < rs->num_records; j++) {
+			due = rs->record_due[j];
+			if (due > 0.0 && due < min_due)
+				min_due = due;
+		}
+	}
+
+	if (min_due == INFINITY)
+		return 0.0;
+
+	due = min_due - get_monotonic_time();
+
+	return due > 0.0 ? due : 0.0;
+}
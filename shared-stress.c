@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Stress test of the shared session. Multiple threads submit requests as
+   fast as they can, retrying when the queue is full, and the main thread
+   processes them as the owner of the session. Each accepted request has to
+   get exactly one callback, also when responses are lost (e.g. with the
+   mock server dropping requests) and when the session is destroyed with
+   uncompleted requests. */
+
+#include "chrony.h"
+
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct {
+	pthread_t thread;
+	int id;
+	uint64_t full;
+} Submitter;
+
+static chrony_shared_session *shared;
+static const char *report = "sources";
+static int num_requests = 1000;
+/* Number of callbacks of each request */
+static int *callbacks;
+static atomic_int running_submitters;
+static atomic_int accepted;
+static int completed, ok, no_response, failed;
+
+static double get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void handle_result(chrony_session *s, chrony_err err, void *arg) {
+	int *count = arg;
+
+	(*count)++;
+	completed++;
+
+	if (err == CHRONY_OK)
+		ok++;
+	else if (err == CHRONY_NO_RESPONSE)
+		no_response++;
+	else
+		failed++;
+}
+
+static void *run_submitter(void *arg) {
+	Submitter *t = arg;
+	chrony_err r;
+	int i;
+
+	for (i = 0; i < num_requests; i++) {
+		/* Alternate requests of the number of records and a record */
+		while ((r = chrony_submit_shared_request(shared, report, i % 2 ? 0 : -1,
+							 handle_result,
+							 &callbacks[t->id * num_requests + i])) ==
+		       CHRONY_QUEUE_FULL) {
+			t->full++;
+			sched_yield();
+		}
+
+		if (r != CHRONY_OK) {
+			fprintf(stderr, "Could not submit request: %s\n", chrony_get_error_string(r));
+			break;
+		}
+
+		atomic_fetch_add(&accepted, 1);
+	}
+
+	atomic_fetch_sub(&running_submitters, 1);
+
+	return NULL;
+}
+
+static void process_shared_session(int fd, double max_wait) {
+	struct pollfd pfds[2] = {
+		{ .fd = chrony_get_shared_session_fd(shared), .events = POLLIN },
+		{ .fd = fd, .events = POLLIN },
+	};
+	double timeout;
+	chrony_err r;
+
+	timeout = chrony_get_shared_session_timeout(shared);
+	if (timeout < 0.0 || timeout > max_wait)
+		timeout = max_wait;
+
+	if (poll(pfds, 2, timeout * 1000.0 + 1.0) < 0)
+		return;
+
+	r = chrony_process_shared_session(shared);
+	if (r != CHRONY_OK)
+		fprintf(stderr, "Error: %s\n", chrony_get_error_string(r));
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]... [ADDRESS]\n", name);
+	fprintf(stderr, "\t-t NUMBER\tnumber of submitting threads (4)\n");
+	fprintf(stderr, "\t-n NUMBER\tnumber of requests per thread (1000)\n");
+	fprintf(stderr, "\t-m REPORT\treport to be requested (sources)\n");
+	fprintf(stderr, "\t-T SECONDS\ttimeout of requests (0.1)\n");
+	fprintf(stderr, "\t-d\t\tdestroy the session after submitting all requests\n");
+}
+
+int main(int argc, char **argv) {
+	int i, fd, opt, total, missing = 0, duplicate = 0, num_submitters = 4;
+	double start, duration, last_progress, timeout = 0.1;
+	Submitter submitters[MAX_THREADS];
+	bool destroy = false;
+	uint64_t full = 0;
+	chrony_err r;
+
+	while ((opt = getopt(argc, argv, "t:n:m:T:dh")) != -1) {
+		switch (opt) {
+		case 't':
+			num_submitters = atoi(optarg);
+			break;
+		case 'n':
+			num_requests = atoi(optarg);
+			break;
+		case 'm':
+			report = optarg;
+			break;
+		case 'T':
+			timeout = atof(optarg);
+			break;
+		case 'd':
+			destroy = true;
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (num_submitters < 1 || num_submitters > MAX_THREADS || num_requests < 1 ||
+	    !(timeout > 0.0)) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	total = num_submitters * num_requests;
+	callbacks = calloc(total, sizeof (*callbacks));
+	if (!callbacks)
+		return 1;
+
+	fd = chrony_open_socket(optind < argc ? argv[optind] : NULL);
+	if (fd < 0) {
+		perror("Could not open socket");
+		return 1;
+	}
+
+	r = chrony_init_shared_session(&shared, fd, timeout);
+	if (r != CHRONY_OK) {
+		fprintf(stderr, "Could not create shared session: %s\n",
+			chrony_get_error_string(r));
+		return 1;
+	}
+
+	atomic_init(&running_submitters, num_submitters);
+	atomic_init(&accepted, 0);
+
+	start = get_time();
+
+	for (i = 0; i < num_submitters; i++) {
+		submitters[i].id = i;
+		submitters[i].full = 0;
+		if (pthread_create(&submitters[i].thread, NULL, run_submitter,
+				   &submitters[i]) != 0) {
+			fprintf(stderr, "Could not create thread\n");
+			return 1;
+		}
+	}
+
+	while (atomic_load(&running_submitters) > 0)
+		process_shared_session(fd, 0.01);
+
+	/* Wait for the remaining callbacks, but give up if there is no progress
+	   for much longer than the timeout of requests */
+	last_progress = get_time();
+	while (!destroy && completed < atomic_load(&accepted)) {
+		i = completed;
+		process_shared_session(fd, timeout);
+		if (completed != i)
+			last_progress = get_time();
+		else if (get_time() - last_progress > 10.0 * timeout + 1.0)
+			break;
+	}
+
+	/* Uncompleted requests get their callbacks here */
+	chrony_deinit_shared_session(shared);
+
+	duration = get_time() - start;
+
+	for (i = 0; i < num_submitters; i++) {
+		pthread_join(submitters[i].thread, NULL);
+		full += submitters[i].full;
+	}
+
+	chrony_close_socket(fd);
+
+	for (i = 0; i < total; i++) {
+		if (callbacks[i] < 1)
+			missing++;
+		else if (callbacks[i] > 1)
+			duplicate++;
+	}
+
+	printf("Threads:          %d\n", num_submitters);
+	printf("Duration:         %.3f s\n", duration);
+	printf("Submitted:        %d (%.1f/s)\n", atomic_load(&accepted),
+	       atomic_load(&accepted) / duration);
+	printf("Queue full:       %"PRIu64"\n", full);
+	printf("Completed:        %d\n", completed);
+	printf("OK:               %d\n", ok);
+	printf("No response:      %d\n", no_response);
+	printf("Failed:           %d\n", failed);
+	printf("Missing:          %d\n", missing);
+	printf("Duplicate:        %d\n", duplicate);
+
+	free(callbacks);
+
+	return atomic_load(&accepted) != total || completed != total || missing > 0 ||
+		duplicate > 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Session shared by multiple threads. Any thread can submit requests to
+   a bounded lock-free queue with multiple producers and one consumer. The
+   owner thread takes the requests from the queue, makes them in its
+   session one at a time, and calls the callbacks of the requests with the
+   results. */
+
+#include "message.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHARED_QUEUE_SIZE 256
+
+typedef struct {
+	int report;
+	int record;
+	chrony_shared_callback callback;
+	void *arg;
+} SharedRequest;
+
+typedef struct {
+	atomic_size_t sequence;
+	SharedRequest request;
+} RequestSlot;
+
+struct chrony_shared_session_t {
+	chrony_session *session;
+	int fd;
+	double timeout;
+	/* Pipe waking up the owner after submitting a request */
+	int pipe_fds[2];
+	atomic_bool notified;
+	RequestSlot slots[SHARED_QUEUE_SIZE];
+	atomic_size_t enqueue_pos;
+	size_t dequeue_pos;
+	/* Request waiting for a response */
+	SharedRequest active;
+	bool active_valid;
+	double deadline;
+};
+
+static double get_monotonic_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+chrony_err chrony_init_shared_session(chrony_shared_session **ss, int fd, double timeout) {
+	chrony_err r;
+	size_t i;
+
+	if (!(timeout > 0.0))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*ss = calloc(1, sizeof (**ss));
+	if (!*ss)
+		return CHRONY_NO_MEMORY;
+
+	r = chrony_init_session(&(*ss)->session, fd);
+	if (r != CHRONY_OK) {
+		free(*ss);
+		return r;
+	}
+
+	if (pipe((*ss)->pipe_fds) < 0) {
+		chrony_deinit_session((*ss)->session);
+		free(*ss);
+		return CHRONY_NO_PIPE;
+	}
+
+	fcntl((*ss)->pipe_fds[0], F_SETFL, O_NONBLOCK);
+	fcntl((*ss)->pipe_fds[1], F_SETFL, O_NONBLOCK);
+	fcntl((*ss)->pipe_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl((*ss)->pipe_fds[1], F_SETFD, FD_CLOEXEC);
+
+	(*ss)->fd = fd;
+	(*ss)->timeout = timeout;
+	atomic_init(&(*ss)->notified, false);
+	atomic_init(&(*ss)->enqueue_pos, 0);
+	for (i = 0; i < SHARED_QUEUE_SIZE; i++)
+		atomic_init(&(*ss)->slots[i].sequence, i);
+
+	return CHRONY_OK;
+}
+
+static bool pop_request(chrony_shared_session *ss, SharedRequest *request) {
+	RequestSlot *slot = &ss->slots[ss->dequeue_pos % SHARED_QUEUE_SIZE];
+
+	if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != ss->dequeue_pos + 1)
+		return false;
+
+	*request = slot->request;
+	atomic_store_explicit(&slot->sequence, ss->dequeue_pos + SHARED_QUEUE_SIZE,
+			      memory_order_release);
+	ss->dequeue_pos++;
+
+	return true;
+}
+
+void chrony_deinit_shared_session(chrony_shared_session *ss) {
+	SharedRequest request;
+
+	if (ss->active_valid)
+		ss->active.callback(ss->session, CHRONY_NO_RESPONSE, ss->active.arg);
+
+	while (pop_request(ss, &request))
+		request.callback(ss->session, CHRONY_NO_RESPONSE, request.arg);
+
+	chrony_deinit_session(ss->session);
+	close(ss->pipe_fds[0]);
+	close(ss->pipe_fds[1]);
+	free(ss);
+}
+
+static void notify_owner(chrony_shared_session *ss) {
+	/* Order the store of the sequence before the load of the flag, which
+	   pairs with the fence in chrony_process_shared_session(). Either the
+	   owner sees the request, or this thread sees the cleared flag. */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/* Don't write to the pipe again if the owner was already notified
+	   since its last processing */
+	if (atomic_exchange(&ss->notified, true))
+		return;
+
+	/* The pipe has room for the byte */
+	if (write(ss->pipe_fds[1], "", 1) < 0)
+		return;
+}
+
+chrony_err chrony_submit_shared_request(chrony_shared_session *ss, const char *report_name,
+					int record, chrony_shared_callback callback, void *arg) {
+	size_t pos, sequence;
+	RequestSlot *slot;
+	int report;
+
+	report = get_report_index(report_name);
+	if (!get_report(report))
+		return CHRONY_UNKNOWN_REPORT;
+
+	if (record < -1 || !callback)
+		return CHRONY_INVALID_ARGUMENT;
+
+	pos = atomic_load_explicit(&ss->enqueue_pos, memory_order_relaxed);
+
+	while (1) {
+		slot = &ss->slots[pos % SHARED_QUEUE_SIZE];
+		sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+		if (sequence == pos) {
+			if (atomic_compare_exchange_weak_explicit(&ss->enqueue_pos, &pos, pos + 1,
+								  memory_order_relaxed,
+								  memory_order_relaxed))
+				break;
+		} else if (sequence < pos) {
+			return CHRONY_QUEUE_FULL;
+		} else {
+			pos = atomic_load_explicit(&ss->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	slot->request.report = report;
+	slot->request.record = record;
+	slot->request.callback = callback;
+	slot->request.arg = arg;
+	atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+	notify_owner(ss);
+
+	return CHRONY_OK;
+}
+
+int chrony_get_shared_session_fd(chrony_shared_session *ss) {
+	return ss->pipe_fds[0];
+}
+
+double chrony_get_shared_session_timeout(chrony_shared_session *ss) {
+	double timeout;
+
+	if (!ss->active_valid)
+		return -1.0;
+
+	timeout = ss->deadline - get_monotonic_time();
+
+	return timeout > 0.0 ? timeout : 0.0;
+}
+
+static void complete_request(chrony_shared_session *ss, chrony_err r) {
+	ss->active_valid = false;
+	ss->active.callback(ss->session, r, ss->active.arg);
+}
+
+static void start_requests(chrony_shared_session *ss, double now) {
+	const char *report_name;
+	chrony_err r;
+
+	while (!ss->active_valid && pop_request(ss, &ss->active)) {
+		ss->active_valid = true;
+		report_name = chrony_get_report_name(ss->active.report);
+
+		if (ss->active.record < 0)
+			r = chrony_request_report_number_records(ss->session, report_name);
+		else
+			r = chrony_request_record(ss->session, report_name, ss->active.record);
+
+		/* Some requests don't need a response (e.g. the number of records
+		   of single-record reports) */
+		if (r != CHRONY_OK || !chrony_needs_response(ss->session))
+			complete_request(ss, r);
+		else
+			ss->deadline = now + ss->timeout;
+	}
+}
+
+chrony_err chrony_process_shared_session(chrony_shared_session *ss) {
+	struct pollfd pfd = { .fd = ss->fd, .events = POLLIN };
+	char buf[16];
+	chrony_err r;
+	double now;
+
+	/* Clear the notification before taking the requests from the queue */
+	atomic_store(&ss->notified, false);
+	while (read(ss->pipe_fds[0], buf, sizeof (buf)) > 0)
+		;
+	atomic_thread_fence(memory_order_seq_cst);
+
+	now = get_monotonic_time();
+
+	/* Process all responses waiting on the socket */
+	while (poll(&pfd, 1, 0) > 0 && pfd.revents & (POLLIN | POLLERR)) {
+		if (!ss->active_valid) {
+			/* Drop late responses */
+			if (recv(ss->fd, buf, sizeof (buf), MSG_DONTWAIT) < 0)
+				break;
+			continue;
+		}
+
+		r = chrony_process_response(ss->session);
+		if (r != CHRONY_OK || !chrony_needs_response(ss->session))
+			complete_request(ss, r);
+		start_requests(ss, now);
+	}
+
+	if (ss->active_valid && now >= ss->deadline)
+		complete_request(ss, CHRONY_NO_RESPONSE);
+
+	start_requests(ss, now);
+
+	return CHRONY_OK;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Snapshots of records and detection of changed fields. The records are
+   compared in the wire format. Records which didn't change are found with
+   one memcmp() of all fields, and only changed records are compared field
+   by field. */
+
+#include "message.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct chrony_snapshot_t {
+	Message msg;
+	/* Length of the fields following the header */
+	int data_len;
+};
+
+chrony_err chrony_init_snapshot(chrony_snapshot **snap) {
+	*snap = calloc(1, sizeof (**snap));
+	if (!*snap)
+		return CHRONY_NO_MEMORY;
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_snapshot(chrony_snapshot *snap) {
+	free(snap);
+}
+
+chrony_err chrony_save_snapshot(chrony_snapshot *snap, chrony_session *s) {
+	const Message *msg;
+	int last;
+
+	msg = get_session_record(s);
+	if (!msg || msg->num_fields < 1)
+		return CHRONY_INVALID_ARGUMENT;
+
+	last = msg->num_fields - 1;
+	snap->data_len = get_field_position(msg, last) + get_field_len(msg->fields, last) -
+		RESPONSE_HEADER_LEN;
+
+	memcpy(snap->msg.msg, msg->msg, RESPONSE_HEADER_LEN + snap->data_len);
+	snap->msg.len = msg->len;
+	snap->msg.num_fields = msg->num_fields;
+	snap->msg.fields = msg->fields;
+
+	return CHRONY_OK;
+}
+
+int chrony_diff_snapshots(const chrony_snapshot *snap1, const chrony_snapshot *snap2,
+			  int *fields, int max_fields) {
+	return diff_message_fields(&snap1->msg, &snap2->msg, snap1->data_len, fields, max_fields);
+}
+
+int chrony_diff_record(chrony_session *s, const chrony_snapshot *snap,
+		       int *fields, int max_fields) {
+	const Message *msg;
+
+	msg = get_session_record(s);
+	if (!msg)
+		return -1;
+
+	return diff_message_fields(&snap->msg, msg, snap->data_len, fields, max_fields);
+}
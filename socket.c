@@ -16,12 +16,13 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-#include "chrony.h"
+#include "message.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
@@ -207,19 +208,12 @@ error1:
 	return -1;
 }
 
-static int open_inet_socket(const char *address) {
-	union {
-		struct sockaddr_in in4;
-		struct sockaddr_in6 in6;
-		struct sockaddr sa;
-	} sa;
+bool parse_inet_address(const char *address, SocketAddress *sa) {
 	char buf[256], *addr, *s;
-	int i, fd, port, colons;
+	int i, port, colons;
 
-	if (snprintf(buf, sizeof (buf), "%s", address) >= sizeof (buf)) {
-		errno = EINVAL;
-		return -1;
-	}
+	if (snprintf(buf, sizeof (buf), "%s", address) >= sizeof (buf))
+		return false;
 
 	addr = buf;
 	port = 323;
@@ -230,10 +224,8 @@ static int open_inet_socket(const char *address) {
 	}
 	if (colons == 1 || (colons >= 3 && buf[0] == '[')) {
 		s = strrchr(buf, ':');
-		if (!s || s == buf || s[1] == '\0') {
-			errno = EINVAL;
-			return -1;
-		}
+		if (!s || s == buf || s[1] == '\0')
+			return false;
 		if (colons >= 3 && s[-1] == ']') {
 			addr = buf + 1;
 			s[-1] = '\0';
@@ -242,15 +234,26 @@ static int open_inet_socket(const char *address) {
 		port = atoi(s + 1);
 	}
 
-	memset(&sa, 0, sizeof (sa));
+	memset(sa, 0, sizeof (*sa));
 
-	if (inet_pton(AF_INET, addr, &sa.in4.sin_addr.s_addr) == 1) {
-		sa.in4.sin_port = htons(port);
-		sa.in4.sin_family = AF_INET;
-	} else if (inet_pton(AF_INET6, addr, &sa.in6.sin6_addr.s6_addr) == 1) {
-		sa.in6.sin6_port = htons(port);
-		sa.in6.sin6_family = AF_INET6;
+	if (inet_pton(AF_INET, addr, &sa->in4.sin_addr.s_addr) == 1) {
+		sa->in4.sin_port = htons(port);
+		sa->in4.sin_family = AF_INET;
+	} else if (inet_pton(AF_INET6, addr, &sa->in6.sin6_addr.s6_addr) == 1) {
+		sa->in6.sin6_port = htons(port);
+		sa->in6.sin6_family = AF_INET6;
 	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static int open_inet_socket(const char *address) {
+	SocketAddress sa;
+	int fd;
+
+	if (!parse_inet_address(address, &sa)) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -259,7 +262,7 @@ static int open_inet_socket(const char *address) {
 	if (fd < 0)
 		return -1;
 
-	if (connect(fd, (struct sockaddr *)&sa, sizeof (sa)) < 0) {
+	if (connect(fd, &sa.sa, sizeof (sa)) < 0) {
 		close(fd);
 		return -1;
 	}
@@ -267,6 +270,34 @@ static int open_inet_socket(const char *address) {
 	return fd;
 }
 
+/* Result of an opening passed through the pipe of the opener */
+typedef struct {
+	int fd;
+	int error;
+} OpeningResult;
+
+/* State shared by the opener and the detached thread opening the socket.
+   If the opener is destroyed before the thread finishes, the thread closes
+   the socket instead of passing it through the pipe. The last of the two
+   frees the state. */
+typedef struct {
+	pthread_mutex_t lock;
+	int refs;
+	bool abandoned;
+	int pipe_fd;
+	char address[];
+} OpeningThread;
+
+struct chrony_opener_t {
+	/* Pipe passing the result of the opening */
+	int pipe_fds[2];
+	OpeningThread *thread;
+	bool completed;
+	/* Opened socket and the errno of a failed opening */
+	int fd;
+	int error;
+};
+
 int chrony_open_socket(const char *address) {
 	int fd;
 
@@ -287,7 +318,198 @@ int chrony_open_socket(const char *address) {
 		return open_inet_socket(address);
 }
 
+int chrony_open_multiplexer_socket(void) {
+	int fd, off = 0;
+
+	/* Prefer an IPv6 socket accepting also IPv4-mapped addresses */
+	fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd >= 0) {
+		if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof (off)) == 0)
+			return fd;
+		close(fd);
+	}
+
+	return socket(AF_INET, SOCK_DGRAM, 0);
+}
+
 void chrony_close_socket(int fd) {
 	remove_unix_socket(fd);
 	close(fd);
 }
+
+static void complete_opening(int pipe_fd, int fd, int error) {
+	OpeningResult result = { .fd = fd, .error = fd < 0 ? error : 0 };
+
+	/* The empty pipe has room for the result, which is written atomically */
+	if (write(pipe_fd, &result, sizeof (result)) != sizeof (result) && fd >= 0)
+		chrony_close_socket(fd);
+}
+
+static void release_thread(OpeningThread *t) {
+	bool last;
+
+	pthread_mutex_lock(&t->lock);
+	last = --t->refs == 0;
+	pthread_mutex_unlock(&t->lock);
+
+	if (!last)
+		return;
+
+	pthread_mutex_destroy(&t->lock);
+	free(t);
+}
+
+static void *open_socket_thread(void *arg) {
+	OpeningThread *t = arg;
+	int fd, error;
+
+	fd = chrony_open_socket(t->address);
+	error = errno;
+
+	pthread_mutex_lock(&t->lock);
+	if (t->abandoned) {
+		if (fd >= 0)
+			chrony_close_socket(fd);
+	} else {
+		complete_opening(t->pipe_fd, fd, error);
+	}
+	pthread_mutex_unlock(&t->lock);
+
+	release_thread(t);
+
+	return NULL;
+}
+
+static bool start_thread(chrony_opener *o, const char *address) {
+	OpeningThread *t;
+	pthread_t thread;
+
+	t = malloc(sizeof (*t) + strlen(address) + 1);
+	if (!t)
+		return false;
+
+	strcpy(t->address, address);
+	t->refs = 2;
+	t->abandoned = false;
+	t->pipe_fd = o->pipe_fds[1];
+
+	if (pthread_mutex_init(&t->lock, NULL) != 0) {
+		free(t);
+		return false;
+	}
+
+	if (pthread_create(&thread, NULL, open_socket_thread, t) != 0) {
+		pthread_mutex_destroy(&t->lock);
+		free(t);
+		return false;
+	}
+
+	pthread_detach(thread);
+	o->thread = t;
+
+	return true;
+}
+
+chrony_err chrony_init_opener(chrony_opener **o, const char *address) {
+	int fd;
+
+	if (!address)
+		address = "";
+
+	*o = calloc(1, sizeof (**o));
+	if (!*o)
+		return CHRONY_NO_MEMORY;
+
+	(*o)->fd = -1;
+
+	if (pipe((*o)->pipe_fds) < 0) {
+		free(*o);
+		return CHRONY_NO_PIPE;
+	}
+
+	fcntl((*o)->pipe_fds[0], F_SETFL, O_NONBLOCK);
+	fcntl((*o)->pipe_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl((*o)->pipe_fds[1], F_SETFD, FD_CLOEXEC);
+
+	/* UDP sockets are opened without blocking. The Unix domain socket needs
+	   a connection probe and creation of directories in the filesystem,
+	   which is done in a separate thread. If the thread cannot be started,
+	   the socket is opened here. */
+	if (address[0] != '/' && address[0] != '\0') {
+		fd = open_inet_socket(address);
+		complete_opening((*o)->pipe_fds[1], fd, errno);
+	} else if (!start_thread(*o, address)) {
+		fd = chrony_open_socket(address);
+		complete_opening((*o)->pipe_fds[1], fd, errno);
+	}
+
+	return CHRONY_OK;
+}
+
+static bool read_result(chrony_opener *o) {
+	OpeningResult result;
+
+	if (read(o->pipe_fds[0], &result, sizeof (result)) != sizeof (result))
+		return false;
+
+	o->fd = result.fd;
+	o->error = result.error;
+	o->completed = true;
+
+	/* The thread doesn't access the opener after passing the result */
+	if (o->thread) {
+		release_thread(o->thread);
+		o->thread = NULL;
+	}
+
+	return true;
+}
+
+void chrony_deinit_opener(chrony_opener *o) {
+	/* Don't wait for the thread. After it is marked as abandoned, it
+	   either has already written the result to the pipe, or it will close
+	   the socket itself. */
+	if (o->thread) {
+		pthread_mutex_lock(&o->thread->lock);
+		o->thread->abandoned = true;
+		pthread_mutex_unlock(&o->thread->lock);
+	}
+
+	if (!o->completed)
+		read_result(o);
+
+	if (o->thread)
+		release_thread(o->thread);
+
+	if (o->fd >= 0)
+		chrony_close_socket(o->fd);
+
+	close(o->pipe_fds[0]);
+	close(o->pipe_fds[1]);
+	free(o);
+}
+
+int chrony_get_opener_fd(chrony_opener *o) {
+	return o->pipe_fds[0];
+}
+
+int chrony_get_opened_socket(chrony_opener *o) {
+	int fd;
+
+	if (!o->completed && !read_result(o)) {
+		errno = EINPROGRESS;
+		return -1;
+	}
+
+	if (o->fd < 0) {
+		errno = o->error ? o->error : EBADF;
+		return -1;
+	}
+
+	/* The socket is owned by the caller now */
+	fd = o->fd;
+	o->fd = -1;
+	o->error = EBADF;
+
+	return fd;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Streaming statistics of the fields of records with fixed memory. Each
+   field has a sketch of the distribution of values for quantiles, which
+   uses logarithmic buckets with a constant relative error, i.e. the error
+   of an offset of a microsecond is in nanoseconds. */
+
+#include "message.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_STATS_FIELDS 32
+#define MAX_STATS_PLANS 4
+
+/* Range of absolute values in the sketch (smaller values are in the zero
+   bucket and larger values in the last bucket) and the number of buckets
+   per octave */
+#define MIN_SKETCH_EXP -40
+#define MAX_SKETCH_EXP 24
+#define SKETCH_SUBBUCKETS 8
+#define SKETCH_BUCKETS ((MAX_SKETCH_EXP - MIN_SKETCH_EXP) * SKETCH_SUBBUCKETS)
+
+typedef struct {
+	char *name;
+	chrony_field_content content;
+	chrony_stats_summary summary;
+	double sum;
+	bool ewma_valid;
+	/* Buckets of negative values (in decreasing order), zero, and positive
+	   values (in increasing order) */
+	uint32_t *sketch;
+} FieldStats;
+
+/* Positions of the measurement fields in one version of a report and
+   their statistics */
+typedef struct {
+	const Field *record_fields;
+	ProjectedField fields[MAX_STATS_FIELDS];
+	int stats[MAX_STATS_FIELDS];
+	int num_fields;
+} UpdatePlan;
+
+struct chrony_stats_t {
+	double ewma_weight;
+	FieldStats fields[MAX_STATS_FIELDS];
+	int num_fields;
+	/* Field expected in the next lookup */
+	int next_field;
+	UpdatePlan plans[MAX_STATS_PLANS];
+	int next_plan;
+};
+
+static bool is_measurement(chrony_field_content content) {
+	switch (content) {
+	case CHRONY_CONTENT_INTERVAL_SECONDS:
+	case CHRONY_CONTENT_OFFSET_SECONDS:
+	case CHRONY_CONTENT_MEASURE_SECONDS:
+	case CHRONY_CONTENT_OFFSET_PPM:
+	case CHRONY_CONTENT_MEASURE_PPM:
+	case CHRONY_CONTENT_OFFSET_PPM_PER_SECOND:
+	case CHRONY_CONTENT_RATIO:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int get_sketch_bucket(double value) {
+	int exp, bucket;
+	double m;
+
+	m = frexp(fabs(value), &exp);
+
+	if (m == 0.0 || exp <= MIN_SKETCH_EXP)
+		return SKETCH_BUCKETS;
+
+	if (exp > MAX_SKETCH_EXP) {
+		bucket = SKETCH_BUCKETS - 1;
+	} else {
+		/* The mantissa is in the interval [0.5, 1) */
+		bucket = (exp - MIN_SKETCH_EXP - 1) * SKETCH_SUBBUCKETS +
+			(int)((2.0 * m - 1.0) * SKETCH_SUBBUCKETS);
+	}
+
+	return value < 0.0 ? SKETCH_BUCKETS - 1 - bucket : SKETCH_BUCKETS + 1 + bucket;
+}
+
+static double get_sketch_value(int bucket) {
+	int b, exp;
+	double m;
+
+	if (bucket == SKETCH_BUCKETS)
+		return 0.0;
+
+	b = bucket > SKETCH_BUCKETS ? bucket - SKETCH_BUCKETS - 1 : SKETCH_BUCKETS - 1 - bucket;
+	exp = b / SKETCH_SUBBUCKETS + MIN_SKETCH_EXP + 1;
+	m = 0.5 * (1.0 + (b % SKETCH_SUBBUCKETS + 0.5) / SKETCH_SUBBUCKETS);
+
+	return bucket > SKETCH_BUCKETS ? ldexp(m, exp) : -ldexp(m, exp);
+}
+
+chrony_err chrony_init_stats(chrony_stats **st, double ewma_weight) {
+	if (!(ewma_weight > 0.0 && ewma_weight <= 1.0))
+		return CHRONY_INVALID_ARGUMENT;
+
+	*st = calloc(1, sizeof (**st));
+	if (!*st)
+		return CHRONY_NO_MEMORY;
+
+	(*st)->ewma_weight = ewma_weight;
+
+	return CHRONY_OK;
+}
+
+void chrony_deinit_stats(chrony_stats *st) {
+	int i;
+
+	for (i = 0; i < st->num_fields; i++) {
+		free(st->fields[i].name);
+		free(st->fields[i].sketch);
+	}
+	free(st);
+}
+
+void chrony_reset_stats(chrony_stats *st) {
+	FieldStats *f;
+	int i;
+
+	/* The EWMA is not reset */
+	for (i = 0; i < st->num_fields; i++) {
+		f = &st->fields[i];
+		f->summary.count = 0;
+		f->summary.min = f->summary.max = f->summary.mean = NAN;
+		f->sum = 0.0;
+		memset(f->sketch, 0, (2 * SKETCH_BUCKETS + 1) * sizeof (*f->sketch));
+	}
+}
+
+static FieldStats *get_field_stats(chrony_stats *st, const char *name,
+				   chrony_field_content content) {
+	FieldStats *f;
+	int i, j;
+
+	/* The fields of records are added in the same order */
+	for (i = 0; i < st->num_fields; i++) {
+		j = (st->next_field + i) % st->num_fields;
+		f = &st->fields[j];
+		if (strcmp(f->name, name) == 0) {
+			st->next_field = j + 1;
+			return f;
+		}
+	}
+
+	if (st->num_fields >= MAX_STATS_FIELDS)
+		return NULL;
+
+	f = &st->fields[st->num_fields];
+	f->sketch = calloc(2 * SKETCH_BUCKETS + 1, sizeof (*f->sketch));
+	f->name = strdup(name);
+	if (!f->sketch || !f->name) {
+		free(f->sketch);
+		free(f->name);
+		return NULL;
+	}
+
+	f->content = content;
+	f->summary.min = f->summary.max = f->summary.mean = f->summary.ewma = NAN;
+	st->num_fields++;
+
+	return f;
+}
+
+static void add_value(chrony_stats *st, FieldStats *f, double value) {
+	chrony_stats_summary *s = &f->summary;
+
+	if (!isfinite(value))
+		return;
+
+	if (s->count == 0 || value < s->min)
+		s->min = value;
+	if (s->count == 0 || value > s->max)
+		s->max = value;
+	s->count++;
+	f->sum += value;
+	s->mean = f->sum / s->count;
+
+	if (f->ewma_valid) {
+		s->ewma += st->ewma_weight * (value - s->ewma);
+	} else {
+		s->ewma = value;
+		f->ewma_valid = true;
+	}
+
+	if (f->sketch[get_sketch_bucket(value)] < UINT32_MAX)
+		f->sketch[get_sketch_bucket(value)]++;
+}
+
+chrony_err chrony_add_stats_value(chrony_stats *st, const char *name,
+				  chrony_field_content content, double value) {
+	FieldStats *f;
+
+	if (!name || !is_measurement(content))
+		return CHRONY_INVALID_ARGUMENT;
+
+	f = get_field_stats(st, name, content);
+	if (!f)
+		return CHRONY_NO_MEMORY;
+
+	add_value(st, f, value);
+
+	return CHRONY_OK;
+}
+
+static UpdatePlan *get_update_plan(chrony_stats *st, const Field *record_fields) {
+	const Field *field;
+	UpdatePlan *plan;
+	FieldStats *f;
+	int i;
+
+	for (i = 0; i < MAX_STATS_PLANS; i++) {
+		if (st->plans[i].record_fields == record_fields)
+			return &st->plans[i];
+	}
+
+	/* Replace the oldest plan */
+	plan = &st->plans[st->next_plan];
+	st->next_plan = (st->next_plan + 1) % MAX_STATS_PLANS;
+
+	plan->record_fields = NULL;
+	plan->num_fields = 0;
+
+	for (field = record_fields; field->type != TYPE_NONE; field++) {
+		if (!is_measurement(field->content))
+			continue;
+
+		if (plan->num_fields >= MAX_STATS_FIELDS ||
+		    !resolve_projected_field(record_fields, field->name,
+					     &plan->fields[plan->num_fields]))
+			return NULL;
+
+		f = get_field_stats(st, field->name, field->content);
+		if (!f)
+			return NULL;
+
+		plan->stats[plan->num_fields++] = f - st->fields;
+	}
+
+	plan->record_fields = record_fields;
+
+	return plan;
+}
+
+chrony_err chrony_update_stats(chrony_stats *st, chrony_session *s) {
+	chrony_field_value values[MAX_STATS_FIELDS];
+	const Message *msg;
+	UpdatePlan *plan;
+	double value;
+	int i;
+
+	msg = get_session_record(s);
+	if (!msg)
+		return CHRONY_INVALID_ARGUMENT;
+
+	plan = get_update_plan(st, msg->fields);
+	if (!plan)
+		return CHRONY_NO_MEMORY;
+
+	project_fields(msg, plan->fields, plan->num_fields, values);
+
+	for (i = 0; i < plan->num_fields; i++) {
+		switch (plan->fields[i].value_type) {
+		case CHRONY_TYPE_FLOAT:
+			value = values[i].floating;
+			break;
+		case CHRONY_TYPE_INTEGER:
+			value = values[i].integer;
+			break;
+		case CHRONY_TYPE_UINTEGER:
+			value = values[i].uinteger;
+			break;
+		default:
+			continue;
+		}
+
+		add_value(st, &st->fields[plan->stats[i]], value);
+	}
+
+	return CHRONY_OK;
+}
+
+int chrony_get_stats_number_fields(chrony_stats *st) {
+	return st->num_fields;
+}
+
+const char *chrony_get_stats_field_name(chrony_stats *st, int field) {
+	if (field < 0 || field >= st->num_fields)
+		return NULL;
+
+	return st->fields[field].name;
+}
+
+chrony_field_content chrony_get_stats_field_content(chrony_stats *st, int field) {
+	if (field < 0 || field >= st->num_fields)
+		return CHRONY_CONTENT_NONE;
+
+	return st->fields[field].content;
+}
+
+chrony_err chrony_get_stats_summary(chrony_stats *st, int field, chrony_stats_summary *summary) {
+	if (field < 0 || field >= st->num_fields)
+		return CHRONY_INVALID_ARGUMENT;
+
+	*summary = st->fields[field].summary;
+
+	return CHRONY_OK;
+}
+
+double chrony_get_stats_quantile(chrony_stats *st, int field, double quantile) {
+	uint64_t rank, sum;
+	FieldStats *f;
+	double value;
+	int i;
+
+	if (field < 0 || field >= st->num_fields || !(quantile >= 0.0 && quantile <= 1.0))
+		return NAN;
+
+	f = &st->fields[field];
+	if (f->summary.count == 0)
+		return NAN;
+
+	rank = quantile * (f->summary.count - 1);
+
+	for (i = sum = 0; i < 2 * SKETCH_BUCKETS; i++) {
+		sum += f->sketch[i];
+		if (sum > rank)
+			break;
+	}
+
+	/* Values out of the range of the sketch are in the first and last
+	   bucket with the minimum and maximum */
+	if (i == 0)
+		return f->summary.min;
+	if (i == 2 * SKETCH_BUCKETS)
+		return f->summary.max;
+
+	/* The error is limited also by the observed minimum and maximum */
+	value = get_sketch_value(i);
+	if (value < f->summary.min)
+		value = f->summary.min;
+	if (value > f->summary.max)
+		value = f->summary.max;
+
+	return value;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "synth.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#define REFCLOCK_REFID 0x47505300 /* GPS */
+
+bool synth_is_refclock(int source) {
+	return source % 8 == 7;
+}
+
+void synth_get_source_address(int source, char *address) {
+	memset(address, 0, 20);
+
+	/* Reference clocks don't have an address */
+	if (synth_is_refclock(source))
+		return;
+
+	/* 10.x.y.z, or 2001:db8::x:y:z for every other source */
+	if (source % 2 == 0) {
+		*(uint32_t *)address = htonl(0x0a000000 | (source + 1));
+		*(uint16_t *)(address + 16) = htons(1);
+	} else {
+		*(uint32_t *)address = htonl(0x20010db8);
+		*(uint32_t *)(address + 12) = htonl(source + 1);
+		*(uint16_t *)(address + 16) = htons(2);
+	}
+}
+
+int synth_find_source(const char *address) {
+	char addr[20];
+	int family;
+
+	family = ntohs(*(uint16_t *)(address + 16));
+	if (family == 1)
+		return (ntohl(*(uint32_t *)address) & 0xffffff) - 1;
+	if (family != 2)
+		return -1;
+
+	/* Validate the IPv6 prefix */
+	synth_get_source_address(1, addr);
+	if (memcmp(address, addr, 12) != 0)
+		return -1;
+
+	return ntohl(*(uint32_t *)(address + 12)) - 1;
+}
+
+static uint32_t encode_float(double x) {
+	int32_t exp, coef;
+
+	/* Inverse of get_field_float(), 7-bit exponent and 25-bit coefficient */
+	if (x == 0.0)
+		return 0;
+
+	frexp(x, &exp);
+	coef = lrint(ldexp(x, 24 - exp));
+	if (coef >= 1 << 24 || coef < -(1 << 24)) {
+		coef /= 2;
+		exp++;
+	}
+	exp += 1;
+	if (exp < -64 || exp > 63)
+		return 0;
+
+	return (uint32_t)exp << 25 | ((uint32_t)coef & ((1U << 25) - 1));
+}
+
+static uint32_t hash(uint32_t x, uint32_t y) {
+	x = x * 2654435761U ^ (y + 0x9e3779b9U);
+	x ^= x >> 15;
+	x *= 0x2c1b3c6dU;
+	x ^= x >> 12;
+	return x;
+}
+
+static uint64_t get_uinteger_value(const Field *field, int index, int source, int num_sources) {
+	const Constant *c = field->constants ? field->constants->list : NULL;
+	uint32_t h = hash(source, index);
+	uint64_t flags;
+	int i, n;
+
+	switch (field->content) {
+	case CHRONY_CONTENT_ENUM:
+		assert(c);
+		if (strcmp(field->name, "mode") == 0 && c[2].name &&
+		    strcmp(c[2].name, "reference clock") == 0)
+			return synth_is_refclock(source) ? 2 : 0;
+		for (n = 0; c[n].name; n++)
+			;
+		return c[h % n].value;
+	case CHRONY_CONTENT_FLAGS:
+		assert(c);
+		for (i = 0, flags = 0; c[i].name; i++) {
+			if (h & (1U << i))
+				flags |= c[i].value;
+		}
+		return flags;
+	case CHRONY_CONTENT_COUNT:
+		if (strcmp(field->name, "sources") == 0)
+			return num_sources;
+		if (strcmp(field->name, "stratum") == 0)
+			return 1 + h % 15;
+		if (strcmp(field->name, "version") == 0)
+			return 4;
+		return h % 1000;
+	case CHRONY_CONTENT_REFERENCE_ID:
+		return synth_is_refclock(source) ? REFCLOCK_REFID : 0x0a000000 | (source + 1);
+	case CHRONY_CONTENT_INTERVAL_SECONDS:
+		return h % 1024;
+	case CHRONY_CONTENT_BITS:
+		return 0377;
+	case CHRONY_CONTENT_PORT:
+		return 123;
+	case CHRONY_CONTENT_INDEX:
+		return source;
+	case CHRONY_CONTENT_LENGTH_BITS:
+		return 256;
+	case CHRONY_CONTENT_LENGTH_BYTES:
+		return 100;
+	case CHRONY_CONTENT_BOOLEAN:
+		return h % 2;
+	default:
+		return 0;
+	}
+}
+
+static int64_t get_integer_value(const Field *field, int index, int source) {
+	uint32_t h = hash(source, index);
+
+	switch (field->content) {
+	case CHRONY_CONTENT_INTERVAL_LOG2_SECONDS:
+		/* Polling interval or precision */
+		return strcmp(field->name, "precision") == 0 ? -20 - (int)(h % 5) : 6 + (int)(h % 5);
+	default:
+		return (int)(h % 21) - 10;
+	}
+}
+
+static double get_float_value(const Field *field, int index, int source) {
+	double x = hash(source, index) / 4294967296.0;
+
+	switch (field->content) {
+	case CHRONY_CONTENT_OFFSET_SECONDS:
+		return (x - 0.5) * 1e-3;
+	case CHRONY_CONTENT_MEASURE_SECONDS:
+		return x * 1e-3;
+	case CHRONY_CONTENT_OFFSET_PPM:
+		return (x - 0.5) * 20.0;
+	case CHRONY_CONTENT_MEASURE_PPM:
+		return x;
+	case CHRONY_CONTENT_OFFSET_PPM_PER_SECOND:
+		return (x - 0.5) * 1e-3;
+	case CHRONY_CONTENT_INTERVAL_SECONDS:
+		return x * 1024.0;
+	case CHRONY_CONTENT_RATIO:
+		return x * 2.0;
+	default:
+		return x;
+	}
+}
+
+static void write_field(Message *msg, int pos, const Field *field, int index,
+			int source, int num_sources) {
+	char *data = msg->msg + pos;
+	uint64_t uval;
+
+	switch (field->type) {
+	case TYPE_UINT64:
+		uval = get_uinteger_value(field, index, source, num_sources);
+		*(uint32_t *)data = htonl(uval >> 32);
+		*(uint32_t *)(data + 4) = htonl(uval);
+		break;
+	case TYPE_UINT32:
+		*(uint32_t *)data = htonl(get_uinteger_value(field, index, source, num_sources));
+		break;
+	case TYPE_UINT16:
+		*(uint16_t *)data = htons(get_uinteger_value(field, index, source, num_sources));
+		break;
+	case TYPE_UINT8:
+		*(uint8_t *)data = get_uinteger_value(field, index, source, num_sources);
+		break;
+	case TYPE_INT16:
+		*(uint16_t *)data = htons(get_integer_value(field, index, source));
+		break;
+	case TYPE_INT8:
+		*(int8_t *)data = get_integer_value(field, index, source);
+		break;
+	case TYPE_FLOAT:
+		*(uint32_t *)data = htonl(encode_float(get_float_value(field, index, source)));
+		break;
+	case TYPE_ADDRESS:
+		if (strcmp(field->name, "local address") == 0) {
+			memset(data, 0, 20);
+			*(uint32_t *)data = htonl(0x0afffffe);
+			*(uint16_t *)(data + 16) = htons(1);
+		} else {
+			synth_get_source_address(source, data);
+		}
+		break;
+	case TYPE_ADDRESS_OR_UINT32_IN_ADDRESS:
+		/* Reference ID of a reference clock is passed as an IPv4 address */
+		synth_get_source_address(source, data);
+		if (synth_is_refclock(source)) {
+			*(uint32_t *)data = htonl(REFCLOCK_REFID);
+			*(uint16_t *)(data + 16) = htons(1);
+		}
+		break;
+	case TYPE_TIMESPEC:
+		*(uint32_t *)data = 0;
+		*(uint32_t *)(data + 4) = htonl(1700000000 + hash(source, index) % 1000000);
+		*(uint32_t *)(data + 8) = htonl(hash(index, source) % 1000000000);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+static void format_header(Message *msg, const Message *request, uint16_t code, int status) {
+	memset(msg, 0, sizeof (*msg));
+
+	msg->msg[0] = 6; /* Protocol version */
+	msg->msg[1] = 2; /* Response type */
+	memcpy(&msg->msg[4], &request->msg[4], 2); /* Command */
+	*(uint16_t *)&msg->msg[6] = htons(code);
+	*(uint16_t *)&msg->msg[8] = htons(status);
+	memcpy(&msg->msg[16], &request->msg[8], 4); /* Sequence */
+	msg->len = RESPONSE_HEADER_LEN;
+}
+
+void synth_format_response(Message *msg, const Message *request, const Response *response,
+			   int source, int num_sources) {
+	int i, n;
+
+	format_header(msg, request, response->code, SYNTH_STATUS_SUCCESS);
+
+	for (n = 0; response->fields[n].type != TYPE_NONE; n++)
+		;
+
+	msg->fields = response->fields;
+	msg->num_fields = n + 1;
+
+	for (i = 0; i < n; i++)
+		write_field(msg, get_field_position(msg, i), &msg->fields[i], i,
+			    source, num_sources);
+
+	msg->len = get_field_position(msg, n);
+
+	/* Leave the message as it would be received from the socket */
+	msg->num_fields = 0;
+	msg->fields = NULL;
+}
+
+void synth_format_status(Message *msg, const Message *request, int status) {
+	/* The response code doesn't matter with an error status */
+	format_header(msg, request, 1, status);
+}
+
+int synth_find_report(const Message *request, bool *count) {
+	const Report *report;
+	uint16_t code;
+	int i;
+
+	code = ntohs(*(uint16_t *)&request->msg[4]);
+
+	for (i = 0; (report = get_report(i)); i++) {
+		if (report->count_requests[0].code == code && code != 0) {
+			*count = true;
+			return i;
+		}
+		if (report->record_requests[0].code == code) {
+			*count = false;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool synth_respond(Message *response, const Message *request, const SynthConfig *config) {
+	const Response *responses;
+	const Request *req;
+	const Report *report;
+	int i, variant, source, req_len, res_len;
+	bool count = false;
+
+	if (request->len < REQUEST_HEADER_LEN || request->msg[1] != 1)
+		return false;
+
+	if (request->msg[0] != 6) {
+		synth_format_status(response, request, SYNTH_STATUS_BADPKTVERSION);
+		return true;
+	}
+
+	report = get_report(synth_find_report(request, &count));
+	if (!report) {
+		synth_format_status(response, request, SYNTH_STATUS_INVALID);
+		return true;
+	}
+
+	req = count ? &report->count_requests[0] : &report->record_requests[0];
+	responses = count ? report->count_responses : report->record_responses;
+
+	for (i = variant = 0; i < MAX_RESPONSES && responses[i].fields; i++) {
+		if (i <= config->response_variant)
+			variant = i;
+	}
+
+	/* The request needs to be padded to the length of the response */
+	req_len = REQUEST_HEADER_LEN;
+	if (req->fields) {
+		assert(req->fields[0].type == TYPE_UINT32 || req->fields[0].type == TYPE_ADDRESS);
+		req_len += req->fields[0].type == TYPE_UINT32 ? 4 : 20;
+	}
+	res_len = get_response_len(&responses[variant]);
+
+	if (request->len < req_len || request->len < res_len) {
+		synth_format_status(response, request, SYNTH_STATUS_BADPKTLENGTH);
+		return true;
+	}
+
+	source = 0;
+
+	if (req->fields) {
+		if (req->fields[0].type == TYPE_UINT32)
+			source = ntohl(*(uint32_t *)&request->msg[REQUEST_HEADER_LEN]);
+		else
+			source = synth_find_source(&request->msg[REQUEST_HEADER_LEN]);
+		if (source < 0 || source >= config->num_sources) {
+			synth_format_status(response, request, SYNTH_STATUS_NOSUCHSOURCE);
+			return true;
+		}
+	}
+
+	synth_format_response(response, request, &responses[variant], source,
+			      config->num_sources);
+
+	return true;
+}
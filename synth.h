@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include "message.h"
+
+/* Generator of synthetic, but valid, chronyd responses for the benchmark
+   and testing tools. Each source has a stable address derived from its
+   index, every eighth source is a reference clock. */
+
+/* Status codes used in chronyd responses */
+#define SYNTH_STATUS_SUCCESS 0
+#define SYNTH_STATUS_UNAUTH 2
+#define SYNTH_STATUS_INVALID 3
+#define SYNTH_STATUS_NOTENABLED 6
+#define SYNTH_STATUS_NOSUCHSOURCE 7
+#define SYNTH_STATUS_BADPKTVERSION 18
+#define SYNTH_STATUS_BADPKTLENGTH 19
+
+typedef struct {
+	int num_sources;
+	/* Index of the response variant (e.g. 1 for ntpdata2, 3 for
+	   serverstats4) limited by the number of variants of the report */
+	int response_variant;
+} SynthConfig;
+
+bool synth_is_refclock(int source);
+void synth_get_source_address(int source, char *address);
+int synth_find_source(const char *address);
+
+void synth_format_response(Message *msg, const Message *request, const Response *response,
+			   int source, int num_sources);
+void synth_format_status(Message *msg, const Message *request, int status);
+
+int synth_find_report(const Message *request, bool *count);
+bool synth_respond(Message *response, const Message *request, const SynthConfig *config);
+
+#endif
@@ -0,0 +1,551 @@
+/*
+ * Copyright (C) 2026  Miroslav Lichvar
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Tool repeatedly requesting selected reports in one session and printing
+   only the fields which changed since the previous iteration. The values
+   are extracted with projection plans created from the first received
+   record and compared without formatting, which is done only for printed
+   fields. */
+
+#include "chrony.h"
+
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_REPORTS 16
+#define MAX_FIELDS 64
+
+typedef struct {
+	const char *name;
+	chrony_projection *projection;
+	/* Names, indices in the record, types and contents of the fields */
+	const char *field_names[MAX_FIELDS];
+	int field_indices[MAX_FIELDS];
+	chrony_field_type field_types[MAX_FIELDS];
+	chrony_field_content field_contents[MAX_FIELDS];
+	int num_fields;
+	/* Values and their types of the records from the previous iteration */
+	chrony_field_value *values;
+	chrony_field_type *value_types;
+	bool *known_records;
+	int num_records;
+	int max_records;
+} Report;
+
+static Report reports[MAX_REPORTS];
+static int num_reports;
+static chrony_schedule *schedule;
+static int timeout = 1000;
+static bool printed_time;
+
+static chrony_err process_responses(chrony_session *s) {
+	struct pollfd pfd = { .fd = chrony_get_fd(s), .events = POLLIN };
+	int n;
+
+	while (chrony_needs_response(s)) {
+		n = poll(&pfd, 1, timeout);
+		if (n < 0) {
+			perror("poll");
+			return -1;
+		} else if (n == 0) {
+			fprintf(stderr, "Error: No valid response received\n");
+			return -1;
+		}
+		n = chrony_process_response(s);
+		if (n != CHRONY_OK)
+			return n;
+	}
+
+	return CHRONY_OK;
+}
+
+static bool add_report(const char *name) {
+	int i;
+
+	for (i = 0; i < chrony_get_number_supported_reports(); i++) {
+		if (strcmp(chrony_get_report_name(i), name) == 0)
+			break;
+	}
+
+	if (i >= chrony_get_number_supported_reports() || num_reports >= MAX_REPORTS) {
+		fprintf(stderr, "Error: Unknown report %s\n", name);
+		return false;
+	}
+
+	reports[num_reports++].name = chrony_get_report_name(i);
+
+	return true;
+}
+
+static void free_reports(void) {
+	int i;
+
+	for (i = 0; i < num_reports; i++) {
+		if (reports[i].projection)
+			chrony_deinit_projection(reports[i].projection);
+		free(reports[i].values);
+		free(reports[i].value_types);
+		free(reports[i].known_records);
+	}
+}
+
+/* Create the projection plan from the first record of the report */
+static chrony_err init_fields(Report *r, chrony_session *s) {
+	chrony_err err;
+	int i;
+
+	for (i = 0; i < chrony_get_record_number_fields(s) && r->num_fields < MAX_FIELDS; i++) {
+		if (chrony_is_field_reserved(s, i))
+			continue;
+		r->field_names[r->num_fields] = chrony_get_field_name(s, i);
+		r->field_indices[r->num_fields] = i;
+		r->field_contents[r->num_fields] = chrony_get_field_content(s, i);
+		r->num_fields++;
+	}
+
+	err = chrony_init_projection(&r->projection, r->name, r->field_names, r->num_fields);
+	if (err != CHRONY_OK)
+		return err;
+
+	for (i = 0; i < r->num_fields; i++)
+		r->field_types[i] = chrony_get_projection_field_type(r->projection, i);
+
+	return CHRONY_OK;
+}
+
+static bool resize_records(Report *r, int num_records) {
+	chrony_field_value *values;
+	chrony_field_type *value_types;
+	bool *known_records;
+
+	if (num_records > r->max_records) {
+		values = realloc(r->values, num_records * MAX_FIELDS * sizeof (*values));
+		if (!values)
+			return false;
+		r->values = values;
+
+		value_types = realloc(r->value_types,
+				      num_records * MAX_FIELDS * sizeof (*value_types));
+		if (!value_types)
+			return false;
+		r->value_types = value_types;
+
+		known_records = realloc(r->known_records, num_records * sizeof (*known_records));
+		if (!known_records)
+			return false;
+		r->known_records = known_records;
+
+		r->max_records = num_records;
+	}
+
+	if (num_records > r->num_records)
+		memset(r->known_records + r->num_records, 0,
+		       (num_records - r->num_records) * sizeof (*r->known_records));
+	r->num_records = num_records;
+
+	return true;
+}
+
+static bool is_equal_value(chrony_field_type type, const chrony_field_value *v1,
+			   const chrony_field_value *v2) {
+	switch (type) {
+	case CHRONY_TYPE_UINTEGER:
+		return v1->uinteger == v2->uinteger;
+	case CHRONY_TYPE_INTEGER:
+		return v1->integer == v2->integer;
+	case CHRONY_TYPE_FLOAT:
+		/* Compare the representation to not print NaN repeatedly */
+		return memcmp(&v1->floating, &v2->floating, sizeof (v1->floating)) == 0;
+	case CHRONY_TYPE_TIMESPEC:
+		return v1->timespec.tv_sec == v2->timespec.tv_sec &&
+			v1->timespec.tv_nsec == v2->timespec.tv_nsec;
+	case CHRONY_TYPE_STRING:
+		return strcmp(v1->string, v2->string) == 0;
+	default:
+		return true;
+	}
+}
+
+static void print_time(void) {
+	struct timespec ts;
+	struct tm tm;
+	char buf[16];
+
+	if (printed_time)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	localtime_r(&ts.tv_sec, &tm);
+	strftime(buf, sizeof (buf), "%H:%M:%S", &tm);
+	printf("%s.%03d\n", buf, (int)(ts.tv_nsec / 1000000));
+	printed_time = true;
+}
+
+static void print_value(chrony_session *s, int field, chrony_field_type type,
+			chrony_field_content content, const chrony_field_value *v) {
+	const char *str, *flags[64];
+	int i, n;
+
+	switch (type) {
+	case CHRONY_TYPE_UINTEGER:
+		if (v->uinteger == CHRONY_ABSENT_UINTEGER) {
+			printf("-");
+			return;
+		}
+		switch (content) {
+		case CHRONY_CONTENT_REFERENCE_ID:
+			printf("%08"PRIX64, v->uinteger);
+			break;
+		case CHRONY_CONTENT_ENUM:
+			str = chrony_get_field_constant_name(s, field, v->uinteger);
+			if (str)
+				printf("%s", str);
+			else
+				printf("%"PRIu64, v->uinteger);
+			break;
+		case CHRONY_CONTENT_FLAGS:
+			n = chrony_get_field_flag_names(s, field, v->uinteger, flags, 64);
+			for (i = 0; i < n; i++)
+				printf("%s ", flags[i]);
+			break;
+		case CHRONY_CONTENT_BOOLEAN:
+			printf(v->uinteger ? "Yes" : "No");
+			break;
+		default:
+			printf("%"PRIu64, v->uinteger);
+		}
+		break;
+	case CHRONY_TYPE_INTEGER:
+		printf("%"PRId64, v->integer);
+		break;
+	case CHRONY_TYPE_FLOAT:
+		printf("%.9g", v->floating);
+		break;
+	case CHRONY_TYPE_STRING:
+		printf("%s", v->string);
+		break;
+	case CHRONY_TYPE_TIMESPEC:
+		printf("%"PRIu64".%09"PRIu32, (uint64_t)v->timespec.tv_sec,
+		       (uint32_t)v->timespec.tv_nsec);
+		break;
+	default:
+		printf("?");
+		return;
+	}
+
+	switch (content) {
+	case CHRONY_CONTENT_INTERVAL_LOG2_SECONDS:
+		printf(" log2(seconds)");
+		break;
+	case CHRONY_CONTENT_INTERVAL_SECONDS:
+	case CHRONY_CONTENT_OFFSET_SECONDS:
+	case CHRONY_CONTENT_MEASURE_SECONDS:
+		printf(" seconds");
+		break;
+	case CHRONY_CONTENT_OFFSET_PPM:
+	case CHRONY_CONTENT_MEASURE_PPM:
+		printf(" ppm");
+		break;
+	case CHRONY_CONTENT_OFFSET_PPM_PER_SECOND:
+		printf(" ppm per second");
+		break;
+	case CHRONY_CONTENT_LENGTH_BITS:
+		printf(" bits");
+		break;
+	case CHRONY_CONTENT_LENGTH_BYTES:
+		printf(" bytes");
+		break;
+	default:
+		break;
+	}
+}
+
+/* Read the value of a field which is not in the projection plan */
+static void get_field_value(chrony_session *s, int field, chrony_field_type type,
+			    chrony_field_value *v) {
+	const char *str;
+
+	memset(v, 0, sizeof (*v));
+
+	switch (type) {
+	case CHRONY_TYPE_UINTEGER:
+		v->uinteger = chrony_get_field_uinteger(s, field);
+		break;
+	case CHRONY_TYPE_INTEGER:
+		v->integer = chrony_get_field_integer(s, field);
+		break;
+	case CHRONY_TYPE_FLOAT:
+		v->floating = chrony_get_field_float(s, field);
+		break;
+	case CHRONY_TYPE_TIMESPEC:
+		v->timespec = chrony_get_field_timespec(s, field);
+		break;
+	case CHRONY_TYPE_STRING:
+		str = chrony_get_field_string(s, field);
+		if (str)
+			snprintf(v->string, sizeof (v->string), "%s", str);
+		break;
+	default:
+		break;
+	}
+}
+
+static chrony_err update_record(Report *r, chrony_session *s, int record) {
+	chrony_field_value values[MAX_FIELDS], *prev;
+	chrony_field_type type, *prev_types;
+	chrony_field_content content;
+	const char *name;
+	chrony_err err;
+	int i, field;
+
+	if (!r->projection) {
+		err = init_fields(r, s);
+		if (err != CHRONY_OK)
+			return err;
+	}
+
+	err = chrony_project_record(s, r->projection, values);
+	if (err != CHRONY_OK)
+		return err;
+
+	prev = &r->values[record * MAX_FIELDS];
+	prev_types = &r->value_types[record * MAX_FIELDS];
+
+	for (i = 0; i < r->num_fields; i++) {
+		field = r->field_indices[i];
+		name = r->field_names[i];
+		type = r->field_types[i];
+		content = r->field_contents[i];
+
+		/* The address or reference ID depends on the record */
+		if (strcmp(chrony_get_field_name(s, field), name) != 0) {
+			name = chrony_get_field_name(s, field);
+			type = chrony_get_field_type(s, field);
+			content = chrony_get_field_content(s, field);
+			get_field_value(s, field, type, &values[i]);
+		}
+
+		if (r->known_records[record] && prev_types[i] == type &&
+		    is_equal_value(type, &prev[i], &values[i]))
+			continue;
+
+		print_time();
+		printf("  %s", r->name);
+		if (r->num_records > 1)
+			printf(" #%d", record + 1);
+		printf(": %s: ", name);
+		print_value(s, field, type, content, &values[i]);
+		printf("\n");
+
+		prev[i] = values[i];
+		prev_types[i] = type;
+	}
+
+	r->known_records[record] = true;
+
+	return CHRONY_OK;
+}
+
+static chrony_err update_report(Report *r, chrony_session *s) {
+	chrony_err err;
+	int i, n;
+
+	if (!schedule || chrony_is_record_due(schedule, r->name, -1)) {
+		err = chrony_request_report_number_records(s, r->name);
+		if (err == CHRONY_OK)
+			err = process_responses(s);
+		if (err != CHRONY_OK)
+			return err;
+
+		if (schedule)
+			chrony_update_schedule(schedule, s, r->name, -1);
+
+		n = chrony_get_report_number_records(s);
+		if (n != r->num_records) {
+			/* Don't print the number of single-record reports */
+			if (r->num_records > 0 || n != 1) {
+				print_time();
+				printf("  %s: %d records\n", r->name, n);
+			}
+			if (!resize_records(r, n))
+				return CHRONY_NO_MEMORY;
+		}
+	}
+
+	for (i = 0; i < r->num_records; i++) {
+		if (schedule && !chrony_is_record_due(schedule, r->name, i))
+			continue;
+
+		err = chrony_request_record(s, r->name, i);
+		if (err == CHRONY_OK)
+			err = process_responses(s);
+		if (err != CHRONY_OK)
+			return err;
+
+		if (schedule)
+			chrony_update_schedule(schedule, s, r->name, i);
+
+		err = update_record(r, s, i);
+		if (err != CHRONY_OK)
+			return err;
+	}
+
+	return CHRONY_OK;
+}
+
+static void add_interval(struct timespec *ts, double interval) {
+	ts->tv_sec += (time_t)interval;
+	ts->tv_nsec += (interval - (time_t)interval) * 1e9;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static void print_usage(const char *name) {
+	fprintf(stderr, "Usage: %s [OPTION]... [ADDRESS] [REPORT]...\n", name);
+	fprintf(stderr, "\t-i SECONDS\tinterval between requests of the reports (1)\n");
+	fprintf(stderr, "\t-c NUMBER\tnumber of iterations (unlimited)\n");
+	fprintf(stderr, "\t-T SECONDS\ttimeout of requests (1)\n");
+	fprintf(stderr, "\t-a\t\trequest only records which can have new data\n");
+}
+
+int main(int argc, char **argv) {
+	int i, j, fd, opt, count = 0;
+	struct timespec next, now;
+	const char *address = NULL;
+	double interval = 1.0;
+	bool adaptive = false;
+	chrony_session *s;
+	chrony_err err;
+
+	while ((opt = getopt(argc, argv, "i:c:T:ah")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = atof(optarg);
+			break;
+		case 'c':
+			count = atoi(optarg);
+			break;
+		case 'T':
+			timeout = atof(optarg) * 1000;
+			break;
+		case 'a':
+			adaptive = true;
+			break;
+		default:
+			print_usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	/* The address is optional, but it cannot be a name of a report */
+	if (optind < argc) {
+		for (i = 0; i < chrony_get_number_supported_reports(); i++) {
+			if (strcmp(chrony_get_report_name(i), argv[optind]) == 0)
+				break;
+		}
+		if (i >= chrony_get_number_supported_reports())
+			address = argv[optind++];
+	}
+
+	for (; optind < argc; optind++) {
+		if (!add_report(argv[optind]))
+			return 1;
+	}
+
+	if (num_reports == 0)
+		add_report("tracking");
+
+	if (!(interval >= 0.0) || timeout < 0) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (adaptive && chrony_init_schedule(&schedule, interval, 64.0) != CHRONY_OK)
+		return 1;
+
+	fd = chrony_open_socket(address);
+	if (fd < 0) {
+		perror("Could not open socket");
+		return 1;
+	}
+
+	if (chrony_init_session(&s, fd) != CHRONY_OK) {
+		chrony_close_socket(fd);
+		return 1;
+	}
+
+	/* Find out which reports are available to not request the others */
+	err = chrony_probe_reports(s);
+	if (err == CHRONY_OK)
+		err = process_responses(s);
+	if (err != CHRONY_OK && err != -1)
+		fprintf(stderr, "Error: %s\n", chrony_get_error_string(err));
+
+	for (j = 0; j < num_reports; j++) {
+		err = chrony_get_report_availability(s, reports[j].name);
+		if (err != CHRONY_OK && err != CHRONY_UNEXPECTED_CALL)
+			fprintf(stderr, "Warning: Report %s not available: %s\n",
+				reports[j].name, chrony_get_error_string(err));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for (i = 0; count <= 0 || i < count; i++) {
+		if (i > 0) {
+			add_interval(&next, interval);
+
+			/* Don't try to catch up after a delay */
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec > next.tv_sec ||
+			    (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec))
+				next = now;
+
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		printed_time = false;
+
+		for (j = 0; j < num_reports; j++) {
+			err = chrony_get_report_availability(s, reports[j].name);
+			if (err != CHRONY_OK && err != CHRONY_UNEXPECTED_CALL)
+				continue;
+
+			err = update_report(&reports[j], s);
+			if (err != CHRONY_OK && err != -1)
+				fprintf(stderr, "Error: %s\n", chrony_get_error_string(err));
+		}
+
+		if (printed_time)
+			fflush(stdout);
+	}
+
+	chrony_deinit_session(s);
+	chrony_close_socket(fd);
+	free_reports();
+	if (schedule)
+		chrony_deinit_schedule(schedule);
+
+	return 0;
+}